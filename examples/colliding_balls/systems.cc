@@ -108,7 +108,7 @@ void Graphics::updateEntity(float delta, es::Entity e) {
   Body *body = getManager()->getComponent<Body>(e);
   assert(body);
 
-  Coords *coords = getManager()->getComponent<Coords>(e);
+  Coords *coords = getManager()->writeComponent<Coords>(e);
   assert(coords);
 
   b2Vec2 pos = body->body->GetPosition();
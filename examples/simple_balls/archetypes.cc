@@ -22,18 +22,18 @@
 es::Entity createBall(es::Manager *manager, sf::Vector2f pos) {
   es::Entity e = manager->createEntity();
 
-  manager->addComponent(e, new Position(pos));
-  manager->addComponent(e, new Speed({
+  manager->emplaceComponent<Position>(e, pos);
+  manager->emplaceComponent<Speed>(e, sf::Vector2f(
       static_cast<float>(std::rand() % 500) - 250.0f,
       static_cast<float>(std::rand() % 300) - 150.0f
-  }));
-  manager->addComponent(e, new Coords({ 0., 0.}));
-  manager->addComponent(e, new Look({
+  ));
+  manager->emplaceComponent<Coords>(e, sf::Vector2f(0.0f, 0.0f));
+  manager->emplaceComponent<Look>(e, sf::Color(
     static_cast<sf::Uint8>(std::rand() % 256),
     static_cast<sf::Uint8>(std::rand() % 256),
     static_cast<sf::Uint8>(std::rand() % 256),
     192 // some transparency
-  }));
+  ));
 
   manager->subscribeEntityToSystems(e);
 
@@ -41,9 +41,9 @@ es::Entity createBall(es::Manager *manager, sf::Vector2f pos) {
 }
 
 void destroyBall(es::Manager *manager, es::Entity e) {
-  delete manager->extractComponent<Position>(e);
-  delete manager->extractComponent<Speed>(e);
-  delete manager->extractComponent<Coords>(e);
-  delete manager->extractComponent<Look>(e);
+  manager->destroyComponent<Position>(e);
+  manager->destroyComponent<Speed>(e);
+  manager->destroyComponent<Coords>(e);
+  manager->destroyComponent<Look>(e);
   manager->destroyEntity(e);
 }
@@ -29,10 +29,10 @@ int main() {
 
   // prepare the components
 
-  manager.createStoreFor(Position::type);
-  manager.createStoreFor(Speed::type);
-  manager.createStoreFor(Coords::type);
-  manager.createStoreFor(Look::type);
+  manager.createPooledStoreFor<Position>();
+  manager.createPooledStoreFor<Speed>();
+  manager.createPooledStoreFor<Coords>();
+  manager.createPooledStoreFor<Look>();
 
   sf::RenderWindow window(sf::VideoMode(WIDTH, HEIGHT), "libes demo", sf::Style::Titlebar | sf::Style::Close);
 
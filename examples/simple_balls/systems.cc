@@ -69,10 +69,10 @@ void Input::preUpdate(float delta) {
 }
 
 void Physics::updateEntity(float delta, es::Entity e) {
-  Position *pos = getManager()->getComponent<Position>(e);
+  Position *pos = getManager()->writeComponent<Position>(e);
   assert(pos);
 
-  Speed *speed = getManager()->getComponent<Speed>(e);
+  Speed *speed = getManager()->writeComponent<Speed>(e);
   assert(speed);
 
   // apply gravity
@@ -103,10 +103,10 @@ void Physics::updateEntity(float delta, es::Entity e) {
 
 
 void Graphics::updateEntity(float delta, es::Entity e) {
-  Position *pos = getManager()->getComponent<Position>(e);
+  const Position *pos = getManager()->readComponent<Position>(e);
   assert(pos);
 
-  Coords *coords = getManager()->getComponent<Coords>(e);
+  Coords *coords = getManager()->writeComponent<Coords>(e);
   assert(coords);
 
   coords->vec.x = pos->vec.x;
@@ -119,10 +119,10 @@ void Render::preUpdate(float delta) {
 }
 
 void Render::updateEntity(float delta, es::Entity e) {
-  Coords *coords = getManager()->getComponent<Coords>(e);
+  const Coords *coords = getManager()->readComponent<Coords>(e);
   assert(coords);
 
-  Look *look = getManager()->getComponent<Look>(e);
+  const Look *look = getManager()->readComponent<Look>(e);
   assert(look);
 
   sf::CircleShape shape(RADIUS);
@@ -50,7 +50,10 @@ class Graphics : public es::GlobalSystem {
 public:
   Graphics(es::Manager *manager)
     : GlobalSystem(3, { Position::type, Coords::type }, manager)
-  { }
+  {
+    // only the balls that have moved since the last frame
+    enableChangeFilter({ Position::type });
+  }
 
   virtual void updateEntity(float delta, es::Entity e) override;
 
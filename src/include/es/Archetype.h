@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_ARCHETYPE_H
+#define ES_ARCHETYPE_H
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+#include <es/Component.h>
+#include <es/Entity.h>
+#include <es/Registry.h>
+
+namespace es {
+
+  /**
+   * @brief An archetype.
+   *
+   * An archetype is a table that groups all the entities that have exactly
+   * the same component signature. A row of the table is an entity and there
+   * is a column for each component type of the signature. The columns are
+   * ordered by the index of the component types in the component registry.
+   *
+   * When a component is added to or removed from an entity, the manager
+   * moves the row of the entity to the archetype of its new signature.
+   * The rows of an archetype are packed, so iterating over the entities
+   * with a given set of components is a linear walk over a few tables.
+   *
+   * The columns only hold pointers to the components, that stay in their
+   * stores: the components themselves are not contiguous in memory, and
+   * they are not moved when the row of the entity moves. The contiguous
+   * storage of the values is given by the column stores (see ColumnStore).
+   */
+  class Archetype {
+  public:
+    /**
+     * @brief Create an archetype.
+     *
+     * @param signature the signature of the entities of this archetype
+     */
+    explicit Archetype(const ComponentSignature& signature);
+
+    /**
+     * @brief Get the signature of the archetype.
+     *
+     * @returns the signature of the archetype
+     */
+    const ComponentSignature& getSignature() const {
+      return m_signature;
+    }
+
+    /**
+     * @brief Get the number of rows (entities) in the archetype.
+     *
+     * @returns the number of rows
+     */
+    std::size_t getSize() const {
+      return m_entities.size();
+    }
+
+    /**
+     * @brief Get the number of columns (component types) in the archetype.
+     *
+     * @returns the number of columns
+     */
+    std::size_t getColumnCount() const {
+      return m_columns.size();
+    }
+
+    /**
+     * @brief Get the column of a component type.
+     *
+     * @param ct the component type
+     * @returns the column or INVALID_TYPE_INDEX if the component type is not
+     *   in the signature
+     */
+    std::size_t getColumnIndex(ComponentType ct) const;
+
+    /**
+     * @brief Get the column of a component type.
+     *
+     * @returns the column or INVALID_TYPE_INDEX if the component type is not
+     *   in the signature
+     */
+    template<typename C>
+    std::size_t getColumnIndex() const {
+      std::size_t index = Registry::getComponentIndex<C>();
+      return index == INVALID_TYPE_INDEX ? INVALID_TYPE_INDEX : m_columnOf[index];
+    }
+
+    /**
+     * @brief Get the entity of a row.
+     *
+     * @param row the row
+     * @returns the entity
+     */
+    Entity getEntityAt(std::size_t row) const {
+      assert(row < m_entities.size());
+      return m_entities[row];
+    }
+
+    /**
+     * @brief Get the packed array of entities.
+     *
+     * @returns a pointer to the first entity of the archetype
+     */
+    const Entity *getEntities() const {
+      return m_entities.data();
+    }
+
+    /**
+     * @brief Get the packed array of component pointers of a column.
+     *
+     * @param column the column
+     * @returns a pointer to the pointer to the component of the first row
+     */
+    Component * const *getColumn(std::size_t column) const {
+      assert(column < m_columns.size());
+      return m_columns[column].data();
+    }
+
+    /**
+     * @brief Get a component in the table.
+     *
+     * @param column the column
+     * @param row the row
+     * @returns the component
+     */
+    template<typename C>
+    C *getComponentAt(std::size_t column, std::size_t row) const {
+      assert(column < m_columns.size());
+      assert(row < m_entities.size());
+      return static_cast<C *>(m_columns[column][row]);
+    }
+
+    /**
+     * @brief Set a component in the table.
+     *
+     * @param column the column
+     * @param row the row
+     * @param c the component
+     */
+    void setComponentAt(std::size_t column, std::size_t row, Component *c) {
+      assert(column < m_columns.size());
+      assert(row < m_entities.size());
+      m_columns[column][row] = c;
+    }
+
+    /**
+     * @brief Add a row for an entity.
+     *
+     * The components of the new row are null and must be set afterwards.
+     *
+     * @param e the entity
+     * @returns the new row
+     */
+    std::size_t addRow(Entity e);
+
+    /**
+     * @brief Remove a row.
+     *
+     * The last row is moved in place of the removed row.
+     *
+     * @param row the row
+     * @returns the entity that has been moved in the row or INVALID_ENTITY if
+     *   the removed row was the last row
+     */
+    Entity removeRow(std::size_t row);
+
+  private:
+    const ComponentSignature m_signature;
+    std::size_t m_columnOf[MAX_COMPONENT_TYPES];
+
+    std::vector<Entity> m_entities;
+    std::vector<std::vector<Component *>> m_columns;
+  };
+
+}
+
+#endif // ES_ARCHETYPE_H
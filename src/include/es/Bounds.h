@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_BOUNDS_H
+#define ES_BOUNDS_H
+
+#include <algorithm>
+#include <functional>
+
+#include <es/Component.h>
+
+namespace es {
+
+  /**
+   * @brief An axis-aligned bounding box.
+   *
+   * The box contains the points (x,y) with xmin <= x <= xmax and
+   * ymin <= y <= ymax.
+   */
+  struct Bounds {
+    float xmin;
+    float ymin;
+    float xmax;
+    float ymax;
+
+    /**
+     * @brief Tell whether a box is entirely inside this box.
+     *
+     * @param other the other box
+     * @returns true if the other box is inside this box
+     */
+    bool contains(const Bounds& other) const {
+      return xmin <= other.xmin && other.xmax <= xmax && ymin <= other.ymin && other.ymax <= ymax;
+    }
+
+    /**
+     * @brief Tell whether a box overlaps this box.
+     *
+     * @param other the other box
+     * @returns true if the boxes have at least one point in common
+     */
+    bool overlaps(const Bounds& other) const {
+      return xmin <= other.xmax && other.xmin <= xmax && ymin <= other.ymax && other.ymin <= ymax;
+    }
+
+    /**
+     * @brief Get the perimeter of the box.
+     *
+     * @returns the perimeter
+     */
+    float getPerimeter() const {
+      return 2.0f * ((xmax - xmin) + (ymax - ymin));
+    }
+
+    /**
+     * @brief Get the squared distance between a point and the box.
+     *
+     * @param x the x coordinate of the point
+     * @param y the y coordinate of the point
+     * @returns the squared distance, 0 if the point is inside the box
+     */
+    float getDistanceSquared(float x, float y) const {
+      float dx = std::max(std::max(xmin - x, x - xmax), 0.0f);
+      float dy = std::max(std::max(ymin - y, y - ymax), 0.0f);
+      return dx * dx + dy * dy;
+    }
+
+    /**
+     * @brief Get this box enlarged by a margin on each side.
+     *
+     * @param margin the margin
+     * @returns the enlarged box
+     */
+    Bounds getInflated(float margin) const {
+      return { xmin - margin, ymin - margin, xmax + margin, ymax + margin };
+    }
+
+    /**
+     * @brief Get the smallest box that contains two boxes.
+     *
+     * @param lhs the first box
+     * @param rhs the second box
+     * @returns the union of the boxes
+     */
+    static Bounds merge(const Bounds& lhs, const Bounds& rhs) {
+      return { std::min(lhs.xmin, rhs.xmin), std::min(lhs.ymin, rhs.ymin), std::max(lhs.xmax, rhs.xmax), std::max(lhs.ymax, rhs.ymax) };
+    }
+  };
+
+  /**
+   * @brief A function that gives the bounds of an entity from one of its
+   * components.
+   *
+   * @param component the component
+   * @param bounds the bounds of the entity (output)
+   */
+  typedef std::function<void(const Component *component, Bounds& bounds)> BoundsFunction;
+
+}
+
+#endif // ES_BOUNDS_H
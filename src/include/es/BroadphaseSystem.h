@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_BROADPHASE_SYSTEM_H
+#define ES_BROADPHASE_SYSTEM_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+#include <es/Bounds.h>
+#include <es/Component.h>
+#include <es/System.h>
+#include <es/Entity.h>
+
+namespace es {
+  class ChangeList;
+  class Store;
+
+  /**
+   * @brief A pair of entities whose bounds overlap.
+   */
+  struct ContactPair {
+    Entity first;
+    Entity second;
+  };
+
+  /**
+   * @brief A broadphase system.
+   *
+   * A broadphase system finds the pairs of entities whose bounds overlap,
+   * with a sort and sweep along the x axis. The bounds are given by a
+   * component (see @a bindBounds).
+   *
+   * The bounds are kept in separate arrays (one for each coordinate), sorted
+   * by their minimum x coordinate. As the entities move a little between two
+   * updates, the arrays are sorted again with an insertion sort, that is
+   * almost linear on nearly sorted arrays. Then, the sweep compares the
+   * bounds of an entity with the following entities, four at a time if SSE2
+   * is available, until their minimum x coordinate is greater than the
+   * maximum x coordinate of the entity.
+   *
+   * The pairs of an update are stored in a buffer (see @a getPairs) and
+   * given to @a updatePair.
+   */
+  class BroadphaseSystem : public System {
+  public:
+    /**
+     * @brief Create a broadphase system.
+     *
+     * @param priority the priority of the system (small priority will
+     * be executed first)
+     * @param needed the set of needed component types that an entity must
+     * have to be handled properly by this system
+     * @param manager the manager (that is saved in the system so that the
+     * system can easily access the manager)
+     */
+    BroadphaseSystem(int priority, std::set<ComponentType> needed, Manager *manager)
+      : System(priority, needed, manager), m_boundsType(INVALID_COMPONENT), m_changes(nullptr), m_removed(0)
+    {
+    }
+
+    /**
+     * @brief Add an entity in the system.
+     *
+     * If a bounds component is bound, the entity is added. Otherwise,
+     * nothing is done.
+     *
+     * @param e the entity
+     * @returns true if the entity was added
+     */
+    virtual bool addEntity(Entity e) override;
+
+    /**
+     * @brief Remove an entity from the system.
+     *
+     * @param e the entity
+     * @returns true if the entity was removed
+     */
+    virtual bool removeEntity(Entity e) override;
+
+    /**
+     * @brief Find the pairs of overlapping entities.
+     *
+     * The bounds of the entities whose bounds component has been modified
+     * since the last update are read again, then the pairs are computed and
+     * @a updatePair is called on each pair.
+     *
+     * @param delta the time (in second) since the last update
+     */
+    virtual void update(float delta) override;
+
+    /**
+     * @brief Handle a pair of overlapping entities.
+     *
+     * This function is called by update. By default, do nothing.
+     *
+     * @param delta the time (in second) since the last update
+     * @param first the first entity of the pair
+     * @param second the second entity of the pair
+     */
+    virtual void updatePair(float delta, Entity first, Entity second);
+
+    /**
+     * @brief Bind a bounds component to the system.
+     *
+     * @param ct the bounds component type
+     * @param bounds the function that gives the bounds from the component
+     */
+    void bindBounds(ComponentType ct, BoundsFunction bounds);
+
+    /**
+     * @brief Bind a bounds component to the system.
+     *
+     * The function is called as `fn(const C&, Bounds&)`.
+     *
+     * @param fn the function that gives the bounds from the component
+     */
+    template<typename C, typename Fn>
+    void bindBounds(Fn fn) {
+      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
+      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+      bindBounds(C::type, [fn](const Component *c, Bounds& bounds) {
+        fn(*static_cast<const C *>(c), bounds);
+      });
+    }
+
+    /**
+     * @brief Get the pairs of overlapping entities of the last update.
+     *
+     * The pairs are in no particular order, and each pair appears once.
+     *
+     * @returns the pairs
+     */
+    const std::vector<ContactPair>& getPairs() const {
+      return m_pairs;
+    }
+
+    /**
+     * @brief Get the number of entities in the system.
+     *
+     * @returns the number of entities
+     */
+    std::size_t getEntityCount() const {
+      return m_entities.size() - m_removed;
+    }
+
+  private:
+    static const std::size_t INVALID_SLOT = static_cast<std::size_t>(-1);
+
+    std::size_t findSlot(Entity e) const;
+    void setBounds(std::size_t slot, const Bounds& bounds);
+    void refresh();
+    void refreshSlot(Store *store, std::size_t slot);
+    void compact();
+    void sort();
+    void sweep();
+
+    ComponentType m_boundsType;
+    BoundsFunction m_bounds;
+    ChangeList *m_changes;
+
+    // the bounds, sorted by xmin, and a sparse index by entity index
+    std::vector<float> m_xmin;
+    std::vector<float> m_xmax;
+    std::vector<float> m_ymin;
+    std::vector<float> m_ymax;
+    std::vector<Entity> m_entities;
+    std::vector<std::size_t> m_slots;
+    std::size_t m_removed;
+
+    std::vector<ContactPair> m_pairs;
+  };
+
+}
+
+#endif // ES_BROADPHASE_SYSTEM_H
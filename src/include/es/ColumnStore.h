@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_COLUMN_STORE_H
+#define ES_COLUMN_STORE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <es/Entity.h>
+#include <es/Memory.h>
+
+namespace es {
+
+  /**
+   * @brief A store that keeps each field of a component in its own column.
+   *
+   * This is the untyped part of ColumnStore: the entities are kept in a
+   * sparse set, and the fields of the i-th entity are the i-th elements of
+   * the columns. The columns are aligned on ALIGNMENT bytes and their
+   * capacity is a multiple of PADDING elements, so that a vectorized kernel
+   * can process the last entities with full vectors (the values after
+   * getSize() are unspecified).
+   */
+  class ColumnStoreBase {
+  public:
+    /**
+     * @brief The alignment of the columns, in bytes.
+     */
+    static const std::size_t ALIGNMENT = CACHE_LINE_SIZE;
+
+    /**
+     * @brief The granularity of the capacity of the columns, in elements.
+     */
+    static const std::size_t PADDING = 16;
+
+    /**
+     * @brief Create a column store.
+     *
+     * @param sizes the size of the elements of each column
+     */
+    explicit ColumnStoreBase(std::vector<std::size_t> sizes);
+
+    ColumnStoreBase(const ColumnStoreBase&) = delete;
+    ColumnStoreBase& operator=(const ColumnStoreBase&) = delete;
+
+    virtual ~ColumnStoreBase();
+
+    /**
+     * @brief Tell whether an entity has an element in the store.
+     *
+     * @param e the entity
+     * @returns true if the entity is in the store
+     */
+    bool has(Entity e) const {
+      return find(e) != INVALID_ROW;
+    }
+
+    /**
+     * @brief Get the row of an entity.
+     *
+     * @param e the entity
+     * @returns the row of the entity or INVALID_ROW
+     */
+    std::size_t find(Entity e) const;
+
+    /**
+     * @brief Remove an entity from the store.
+     *
+     * The last entity takes the row of the removed entity.
+     *
+     * @param e the entity
+     * @returns true if the entity was in the store
+     */
+    bool remove(Entity e);
+
+    /**
+     * @brief Get the number of entities in the store.
+     *
+     * @returns the number of entities
+     */
+    std::size_t getSize() const {
+      return m_entities.size();
+    }
+
+    /**
+     * @brief Get the capacity of the columns.
+     *
+     * @returns the capacity, a multiple of PADDING
+     */
+    std::size_t getCapacity() const {
+      return m_capacity;
+    }
+
+    /**
+     * @brief Get the entities of the store, in the order of the rows.
+     *
+     * @returns the entities
+     */
+    const Entity *getEntities() const {
+      return m_entities.data();
+    }
+
+    /**
+     * @brief Get the entity at a row.
+     *
+     * @param row the row (less than getSize())
+     * @returns the entity
+     */
+    Entity getEntityAt(std::size_t row) const {
+      assert(row < m_entities.size());
+      return m_entities[row];
+    }
+
+    /**
+     * @brief An invalid row.
+     */
+    static const std::size_t INVALID_ROW = static_cast<std::size_t>(-1);
+
+  protected:
+    std::size_t insert(Entity e, const void * const *values);
+
+    void *getColumnData(std::size_t column) const {
+      assert(column < m_columns.size());
+      return m_columns[column].data;
+    }
+
+  private:
+    struct Column {
+      std::size_t size;
+      unsigned char *data;
+    };
+
+    void grow();
+
+    std::vector<Column> m_columns;
+    std::size_t m_capacity;
+    std::vector<Entity> m_entities;
+    std::vector<std::size_t> m_rows; // indexed by the index of the entity
+  };
+
+  /**
+   * @brief A store that keeps each field of a component in its own column.
+   *
+   * The fields must be trivial types (e.g. `float`). A component type that
+   * is stored in columns declares its fields with a `Columns` typedef:
+   *
+   * ~~~{.cc}
+   * struct Position : es::Component {
+   *   typedef es::ColumnStore<float, float> Columns; // x, y
+   *   static const es::ComponentType type = "Position"_type;
+   * };
+   * ~~~
+   *
+   * and its store is created with Manager::createColumnStoreFor. The
+   * columns are then available as arrays with @a getColumn.
+   */
+  template<typename ... Fields>
+  class ColumnStore : public ColumnStoreBase {
+    static_assert(sizeof...(Fields) > 0, "ColumnStore requires at least one field");
+  public:
+    /**
+     * @brief The type of a field.
+     */
+    template<std::size_t I>
+    using FieldType = typename std::tuple_element<I, std::tuple<Fields...>>::type;
+
+    ColumnStore()
+    : ColumnStoreBase({ sizeof(Fields)... }) {
+      static_assert(all(std::is_trivial<Fields>::value...), "The fields of a ColumnStore must be trivial");
+    }
+
+    /**
+     * @brief Add an entity in the store.
+     *
+     * @param e the entity
+     * @param values the values of the fields
+     * @returns true if the entity was added
+     */
+    bool add(Entity e, const Fields&... values) {
+      const void *pointers[] = { &values... };
+      return insert(e, pointers) != INVALID_ROW;
+    }
+
+    /**
+     * @brief Get a column.
+     *
+     * The column is aligned on ALIGNMENT bytes and contains getSize()
+     * values.
+     *
+     * @returns the column of the I-th field
+     */
+    template<std::size_t I>
+    FieldType<I> *getColumn() {
+      return static_cast<FieldType<I> *>(getColumnData(I));
+    }
+
+    /**
+     * @brief Get a column.
+     *
+     * @returns the column of the I-th field
+     */
+    template<std::size_t I>
+    const FieldType<I> *getColumn() const {
+      return static_cast<const FieldType<I> *>(getColumnData(I));
+    }
+
+    /**
+     * @brief Get a field of an entity.
+     *
+     * @param e the entity
+     * @returns the I-th field of the entity or nullptr if the entity is not
+     * in the store
+     */
+    template<std::size_t I>
+    FieldType<I> *getField(Entity e) {
+      std::size_t row = find(e);
+      return row == INVALID_ROW ? nullptr : getColumn<I>() + row;
+    }
+
+  private:
+    static constexpr bool all() {
+      return true;
+    }
+
+    template<typename ... Rest>
+    static constexpr bool all(bool first, Rest... rest) {
+      return first && all(rest...);
+    }
+  };
+
+}
+
+#endif // ES_COLUMN_STORE_H
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_COMMAND_BUFFER_H
+#define ES_COMMAND_BUFFER_H
+
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include <es/Component.h>
+#include <es/Entity.h>
+
+namespace es {
+  class Manager;
+
+  /**
+   * @brief A command buffer.
+   *
+   * A command buffer records structural changes (creation and destruction of
+   * entities, addition and removal of components, subscription to systems)
+   * so that they can be applied later, in a batch, when no system is
+   * iterating over its entities. The manager applies its command buffer at
+   * each synchronization point of Manager::updateSystems.
+   *
+   * When the commands are applied, they are sorted by entity (keeping the
+   * order of the commands of each entity) and the subscriptions of an entity
+   * are coalesced in a single subscription after all its other commands. The
+   * commands on an entity that is destroyed are dropped after the
+   * destruction.
+   *
+   * A component whose addition is dropped, or fails, is destroyed: it is
+   * given back to the pool of its store if the store owns its components,
+   * or deleted if it was recorded with its type (see @a addComponent).
+   *
+   * The recording functions can be called concurrently from several
+   * threads.
+   */
+  class CommandBuffer {
+  public:
+    /**
+     * @brief A function that deletes a component of a known type.
+     */
+    typedef void (*Deleter)(Component *c);
+
+    /**
+     * @brief Create a command buffer.
+     *
+     * @param manager the manager on which the commands are applied
+     */
+    explicit CommandBuffer(Manager *manager)
+    : m_manager(manager) {
+    }
+
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+    /**
+     * @brief Record the creation of an entity.
+     *
+     * The handle of the new entity is returned immediately so that other
+     * commands can be recorded on it, but the entity is alive only after
+     * the commands are applied.
+     *
+     * @returns the new entity
+     */
+    Entity createEntity();
+
+    /**
+     * @brief Record the destruction of an entity.
+     *
+     * @param e the entity
+     */
+    void destroyEntity(Entity e);
+
+    /**
+     * @brief Record the addition of a component to an entity.
+     *
+     * If the addition is dropped and the store does not own its components,
+     * the component is deleted with the deleter. Without a deleter, the
+     * caller keeps the ownership of the component.
+     *
+     * @param e the entity
+     * @param ct the component type
+     * @param c the component
+     * @param deleter the function that deletes the component (or null)
+     */
+    void addComponent(Entity e, ComponentType ct, Component *c, Deleter deleter = nullptr);
+
+    /**
+     * @brief Record the addition of a component to an entity.
+     *
+     * If the store does not own its components, the component must have
+     * been allocated with new: it is deleted if the addition is dropped.
+     *
+     * @param e the entity
+     * @param c the component
+     */
+    template<typename C>
+    void addComponent(Entity e, C *c) {
+      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
+      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+      addComponent(e, C::type, c, &deleteComponent<C>);
+    }
+
+    /**
+     * @brief Delete a component of a known type.
+     *
+     * @param c the component
+     */
+    template<typename C>
+    static void deleteComponent(Component *c) {
+      delete static_cast<C *>(c);
+    }
+
+    /**
+     * @brief Record the removal of a component from an entity.
+     *
+     * The component is destroyed when the command is applied, so the
+     * removal can only be recorded if the store owns its components (see
+     * Manager::createPooledStoreFor). Otherwise, the component must be
+     * extracted with Manager::extractComponent outside of the systems.
+     *
+     * @param e the entity
+     * @param ct the component type
+     * @returns true if the removal has been recorded
+     */
+    bool removeComponent(Entity e, ComponentType ct);
+
+    /**
+     * @brief Record the removal of a component from an entity.
+     *
+     * @param e the entity
+     * @returns true if the removal has been recorded
+     */
+    template<typename C>
+    bool removeComponent(Entity e) {
+      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
+      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+      return removeComponent(e, C::type);
+    }
+
+    /**
+     * @brief Record the subscription of an entity to the systems.
+     *
+     * @param e the entity
+     */
+    void subscribeEntity(Entity e);
+
+    /**
+     * @brief Tell whether the buffer has no command.
+     *
+     * @returns true if there is no command
+     */
+    bool isEmpty();
+
+    /**
+     * @brief Apply all the recorded commands to the manager.
+     *
+     * This function must not be called while a system iterates over its
+     * entities.
+     */
+    void apply();
+
+  private:
+    enum class Action {
+      CREATE,
+      ADD,
+      REMOVE,
+      SUBSCRIBE,
+      DESTROY,
+    };
+
+    struct Command {
+      Action action;
+      Entity entity;
+      ComponentType type;
+      Component *component;
+      Deleter deleter;
+    };
+
+    void record(Action action, Entity e, ComponentType ct, Component *c, Deleter deleter);
+    void drop(const Command& command);
+
+    Manager * const m_manager;
+
+    std::mutex m_mutex;
+    std::vector<Command> m_commands;
+    std::vector<Command> m_applied;
+  };
+
+}
+
+#endif // ES_COMMAND_BUFFER_H
@@ -16,6 +16,8 @@
 #ifndef ES_COMPONENT_H
 #define ES_COMPONENT_H
 
+#include <bitset>
+
 #include <es/Type.h>
 
 namespace es {
@@ -30,6 +32,20 @@ namespace es {
 
 #define INVALID_COMPONENT 0
 
+  /**
+   * @brief The maximum number of component types.
+   */
+  static const std::size_t MAX_COMPONENT_TYPES = 64;
+
+  /**
+   * @brief A component signature.
+   *
+   * A component signature is the set of the component types of an entity
+   * (or the set of the component types needed by a system). Each component
+   * type is represented by its index in the component registry.
+   */
+  typedef std::bitset<MAX_COMPONENT_TYPES> ComponentSignature;
+
   /**
    * @brief A component.
    *
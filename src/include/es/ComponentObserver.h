@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_COMPONENT_OBSERVER_H
+#define ES_COMPONENT_OBSERVER_H
+
+#include <functional>
+#include <vector>
+
+#include <es/Component.h>
+#include <es/Entity.h>
+#include <es/EventHandler.h>
+
+namespace es {
+
+  /**
+   * @brief The kind of change that happened to a component.
+   */
+  enum class ComponentEvent {
+    ADDED,   /**< The component has been added to the entity */
+    REMOVED, /**< The component has been removed from the entity */
+    CHANGED, /**< The component has been marked as changed */
+  };
+
+  /**
+   * @brief A component observer.
+   *
+   * An observer receives all the entities that had the same change on a
+   * component type since the last synchronization of the manager. The
+   * entities are sorted and each entity appears only once.
+   *
+   * @param ct the component type
+   * @param event the kind of change
+   * @param entities the entities that have changed
+   * @return the status of the observer at the end
+   */
+  typedef std::function<EventStatus(ComponentType, ComponentEvent, const std::vector<Entity>&)> ComponentObserver;
+
+}
+
+#endif // ES_COMPONENT_OBSERVER_H
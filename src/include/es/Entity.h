@@ -16,6 +16,8 @@
 #ifndef ES_ENTITY_H
 #define ES_ENTITY_H
 
+#include <cstdint>
+
 namespace es {
 
   /**
@@ -23,11 +25,47 @@ namespace es {
    *
    * An entity has a very simple representation: a strictly positive integer.
    * Everything else is in components.
+   *
+   * The integer is a handle made of an index (the lower 32 bits) and a
+   * generation (the upper 32 bits). The index of a destroyed entity is
+   * recycled with a new generation, so that an old handle can be detected
+   * as stale. The index 0 is never used.
    */
-  typedef unsigned long Entity;
+  typedef uint64_t Entity;
 
 #define INVALID_ENTITY 0
 
+  /**
+   * @brief Get the index of an entity.
+   *
+   * @param e the entity
+   * @returns the index of the entity
+   */
+  inline uint32_t getEntityIndex(Entity e) {
+    return static_cast<uint32_t>(e & 0xFFFFFFFF);
+  }
+
+  /**
+   * @brief Get the generation of an entity.
+   *
+   * @param e the entity
+   * @returns the generation of the entity
+   */
+  inline uint32_t getEntityGeneration(Entity e) {
+    return static_cast<uint32_t>(e >> 32);
+  }
+
+  /**
+   * @brief Make an entity from an index and a generation.
+   *
+   * @param index the index of the entity
+   * @param generation the generation of the entity
+   * @returns the entity
+   */
+  inline Entity makeEntity(uint32_t index, uint32_t generation) {
+    return (static_cast<Entity>(generation) << 32) | index;
+  }
+
 }
 
 #endif // ES_ENTITY_H
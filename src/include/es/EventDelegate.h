@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_EVENT_DELEGATE_H
+#define ES_EVENT_DELEGATE_H
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <es/Entity.h>
+#include <es/Event.h>
+#include <es/EventHandler.h>
+#include <es/EventQueue.h>
+
+namespace es {
+
+  /**
+   * @brief A typed event delegate.
+   *
+   * A delegate is a lightweight handler for events of type E: an object
+   * pointer and a function pointer. It is called with the entity that
+   * triggers the event and the event itself, without any cast:
+   * `EventStatus(Entity, const E&)`.
+   *
+   * A delegate does not own its object.
+   */
+  template<typename E>
+  class EventDelegate {
+    static_assert(std::is_base_of<Event, E>::value, "EventDelegate requires a child of Event");
+  public:
+    /**
+     * @brief The type of a free function that handles an event.
+     */
+    typedef EventStatus (*Function)(Entity, const E&);
+
+    /**
+     * @brief Create an empty delegate.
+     */
+    EventDelegate()
+    : m_stub(nullptr) {
+      m_data.object = nullptr;
+    }
+
+    /**
+     * @brief Create a delegate from a free function.
+     *
+     * @param fn the function
+     * @returns the delegate
+     */
+    static EventDelegate fromFunction(Function fn) {
+      EventDelegate delegate;
+      delegate.m_data.function = fn;
+      delegate.m_stub = &callFunction;
+      return delegate;
+    }
+
+    /**
+     * @brief Create a delegate from a method of a class.
+     *
+     * @param object the object on which to call the method
+     * @returns the delegate
+     */
+    template<typename T, EventStatus (T::*Method)(Entity, const E&)>
+    static EventDelegate fromMethod(T *object) {
+      EventDelegate delegate;
+      delegate.m_data.object = object;
+      delegate.m_stub = &callMethod<T, Method>;
+      return delegate;
+    }
+
+    /**
+     * @brief Create a delegate from a callable object.
+     *
+     * @param callable the callable object (that must outlive the delegate)
+     * @returns the delegate
+     */
+    template<typename F>
+    static EventDelegate fromCallable(F *callable) {
+      EventDelegate delegate;
+      delegate.m_data.object = callable;
+      delegate.m_stub = &callCallable<F>;
+      return delegate;
+    }
+
+    /**
+     * @brief Tell whether the delegate is not empty.
+     */
+    explicit operator bool() const {
+      return m_stub != nullptr;
+    }
+
+    /**
+     * @brief Call the delegate.
+     *
+     * @param origin the entity that triggers the event
+     * @param event the event parameters
+     * @returns the status of the delegate at the end
+     */
+    EventStatus operator()(Entity origin, const E& event) const {
+      return m_stub(m_data, origin, event);
+    }
+
+  private:
+    union Data {
+      void *object;
+      Function function;
+    };
+
+    typedef EventStatus (*Stub)(const Data&, Entity, const E&);
+
+    static EventStatus callFunction(const Data& data, Entity origin, const E& event) {
+      return data.function(origin, event);
+    }
+
+    template<typename T, EventStatus (T::*Method)(Entity, const E&)>
+    static EventStatus callMethod(const Data& data, Entity origin, const E& event) {
+      return (static_cast<T *>(data.object)->*Method)(origin, event);
+    }
+
+    template<typename F>
+    static EventStatus callCallable(const Data& data, Entity origin, const E& event) {
+      return (*static_cast<F *>(data.object))(origin, event);
+    }
+
+    Data m_data;
+    Stub m_stub;
+  };
+
+  /**
+   * @brief Tell whether F can be called as a delegate of events of type E.
+   */
+  template<typename F, typename E>
+  class IsEventDelegateCallable {
+    template<typename G>
+    static auto check(int) -> typename std::is_convertible<decltype(std::declval<G&>()(std::declval<Entity>(), std::declval<const E&>())), EventStatus>::type;
+
+    template<typename G>
+    static std::false_type check(...);
+
+  public:
+    static const bool value = decltype(check<F>(0))::value;
+  };
+
+  /**
+   * @brief A list of delegates for an event type.
+   *
+   * This is the type-independent part of TypedHandlerList.
+   */
+  class HandlerList {
+  public:
+    HandlerList() { }
+
+    HandlerList(const HandlerList&) = delete;
+    HandlerList& operator=(const HandlerList&) = delete;
+
+    virtual ~HandlerList();
+
+    /**
+     * @brief Dispatch an event to the delegates.
+     *
+     * @param origin the entity that triggers the event
+     * @param event the event parameters (of the type of the list)
+     */
+    virtual void dispatchEvent(Entity origin, Event *event) = 0;
+
+    /**
+     * @brief Dispatch the available events of a queue to the delegates.
+     *
+     * @param queue the queue (of the type of the list)
+     */
+    virtual void dispatchQueue(EventQueue& queue) = 0;
+  };
+
+  /**
+   * @brief A list of delegates for events of type E.
+   *
+   * The delegates are stored in a flat array and the dispatch is a loop of
+   * direct calls. The delegates that are added during a dispatch are called
+   * from the next dispatch, and the delegates that die are removed at the
+   * end of the outermost dispatch.
+   */
+  template<typename E>
+  class TypedHandlerList : public HandlerList {
+  public:
+    TypedHandlerList()
+    : m_depth(0), m_dirty(false) {
+    }
+
+    /**
+     * @brief Add a delegate.
+     *
+     * @param delegate the delegate
+     */
+    void add(EventDelegate<E> delegate) {
+      m_entries.push_back(Entry(delegate, nullptr));
+    }
+
+    /**
+     * @brief Add a callable object.
+     *
+     * A callable object without state is stored as a free function,
+     * otherwise it is copied once and owned by the list.
+     *
+     * @param fn the callable object
+     */
+    template<typename F>
+    void addCallable(F fn) {
+      addCallable(std::move(fn), std::is_convertible<F, typename EventDelegate<E>::Function>());
+    }
+
+    /**
+     * @brief Dispatch an event to the delegates.
+     *
+     * @param origin the entity that triggers the event
+     * @param event the event parameters
+     */
+    void dispatch(Entity origin, const E& event) {
+      m_depth++;
+      dispatchOne(origin, event, m_entries.size());
+      finish();
+    }
+
+    virtual void dispatchEvent(Entity origin, Event *event) override {
+      dispatch(origin, *static_cast<E *>(event));
+    }
+
+    virtual void dispatchQueue(EventQueue& queue) override {
+      TypedEventQueue<E>& typed = static_cast<TypedEventQueue<E>&>(queue);
+      std::size_t count = m_entries.size();
+      m_depth++;
+
+      for (std::size_t i = 0; i < typed.getSize(); ++i) {
+        dispatchOne(typed.getOriginAt(i), typed.getTypedEventAt(i), count);
+      }
+
+      finish();
+    }
+
+  private:
+    struct CallableBase {
+      virtual ~CallableBase() { }
+    };
+
+    template<typename F>
+    struct Callable : CallableBase {
+      explicit Callable(F f)
+      : fn(std::move(f)) {
+      }
+
+      F fn;
+    };
+
+    struct Entry {
+      Entry(EventDelegate<E> d, CallableBase *o)
+      : delegate(d), owner(o) {
+      }
+
+      EventDelegate<E> delegate;
+      std::unique_ptr<CallableBase> owner;
+    };
+
+    template<typename F>
+    void addCallable(F fn, std::true_type) {
+      add(EventDelegate<E>::fromFunction(fn));
+    }
+
+    template<typename F>
+    void addCallable(F fn, std::false_type) {
+      Callable<F> *callable = new Callable<F>(std::move(fn));
+      m_entries.push_back(Entry(EventDelegate<E>::fromCallable(&callable->fn), callable));
+    }
+
+    void dispatchOne(Entity origin, const E& event, std::size_t count) {
+      for (std::size_t i = 0; i < count; ++i) {
+        // copied, because the array can grow during the call
+        EventDelegate<E> delegate = m_entries[i].delegate;
+
+        if (delegate && delegate(origin, event) == EventStatus::DIE) {
+          m_entries[i].delegate = EventDelegate<E>();
+          m_dirty = true;
+        }
+      }
+    }
+
+    void finish() {
+      m_depth--;
+
+      if (m_depth > 0 || !m_dirty) {
+        return;
+      }
+
+      std::size_t kept = 0;
+
+      for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].delegate) {
+          if (kept != i) {
+            m_entries[kept] = std::move(m_entries[i]);
+          }
+
+          kept++;
+        }
+      }
+
+      m_entries.erase(m_entries.begin() + kept, m_entries.end());
+      m_dirty = false;
+    }
+
+    std::vector<Entry> m_entries;
+    unsigned m_depth;
+    bool m_dirty;
+  };
+
+}
+
+#endif // ES_EVENT_DELEGATE_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_EVENT_QUEUE_H
+#define ES_EVENT_QUEUE_H
+
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include <es/Entity.h>
+#include <es/Event.h>
+
+namespace es {
+
+  /**
+   * @brief A queue of events of the same type.
+   *
+   * The queue is double buffered: the events are pushed in the back buffer
+   * and the buffers are swapped when the events are dispatched, so that new
+   * events can be pushed while the previous ones are dispatched. The events
+   * are stored by value, contiguously.
+   *
+   * This is the type-independent part of TypedEventQueue.
+   */
+  class EventQueue {
+  public:
+    EventQueue() { }
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    virtual ~EventQueue();
+
+    /**
+     * @brief Swap the buffers.
+     *
+     * The events that have been pushed become available with
+     * @a getOriginAt and @a getEventAt. The previous events are discarded.
+     *
+     * @returns the number of available events
+     */
+    std::size_t swap();
+
+    /**
+     * @brief Get the number of available events.
+     *
+     * @returns the number of events in the front buffer
+     */
+    std::size_t getSize() const {
+      return m_frontOrigins.size();
+    }
+
+    /**
+     * @brief Get the origin of an available event.
+     *
+     * @param index the index of the event (less than getSize())
+     * @returns the entity that triggered the event
+     */
+    Entity getOriginAt(std::size_t index) const {
+      assert(index < m_frontOrigins.size());
+      return m_frontOrigins[index];
+    }
+
+    /**
+     * @brief Get an available event.
+     *
+     * @param index the index of the event (less than getSize())
+     * @returns the event
+     */
+    virtual Event *getEventAt(std::size_t index) = 0;
+
+  protected:
+    virtual void swapEvents() = 0;
+
+    std::mutex m_mutex;
+    std::vector<Entity> m_backOrigins;
+
+  private:
+    std::vector<Entity> m_frontOrigins;
+  };
+
+  /**
+   * @brief A queue of events of type E.
+   */
+  template<typename E>
+  class TypedEventQueue : public EventQueue {
+    static_assert(std::is_base_of<Event, E>::value, "TypedEventQueue requires a child of Event");
+  public:
+    /**
+     * @brief Push an event in the queue.
+     *
+     * This function can be called concurrently from several threads.
+     *
+     * @param origin the entity that triggers the event
+     * @param event the event parameters
+     */
+    void push(Entity origin, const E& event) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_backOrigins.push_back(origin);
+      m_backEvents.push_back(event);
+    }
+
+    /**
+     * @brief Get an available event with its type.
+     *
+     * @param index the index of the event (less than getSize())
+     * @returns the event
+     */
+    const E& getTypedEventAt(std::size_t index) const {
+      assert(index < m_frontEvents.size());
+      return m_frontEvents[index];
+    }
+
+    virtual Event *getEventAt(std::size_t index) override {
+      assert(index < m_frontEvents.size());
+      return &m_frontEvents[index];
+    }
+
+  protected:
+    virtual void swapEvents() override {
+      m_frontEvents.clear();
+      std::swap(m_frontEvents, m_backEvents);
+    }
+
+  private:
+    std::vector<E> m_backEvents;
+    std::vector<E> m_frontEvents;
+  };
+
+}
+
+#endif // ES_EVENT_QUEUE_H
@@ -16,10 +16,128 @@
 #ifndef ES_GLOBAL_SYSTEM_H
 #define ES_GLOBAL_SYSTEM_H
 
+#include <cassert>
+#include <cstddef>
+#include <set>
+#include <vector>
+
+#include <es/Manager.h>
 #include <es/System.h>
 
 namespace es {
 
+  /**
+   * @brief A block of entities with their resolved components.
+   *
+   * A chunk has a column of component pointers for each needed component
+   * type of the system, in the order of the component types (the order of
+   * System::getNeededComponents, see GlobalSystem::getChunkColumn). The i-th
+   * pointer of a column is the component of the i-th entity. For a
+   * component type that is stored in columns (see ColumnStore), the
+   * pointers are null and the chunk gives the rows of the entities in the
+   * column store instead (see @a getRowAt).
+   */
+  class Chunk {
+  public:
+    /**
+     * @brief Create a chunk.
+     *
+     * @param entities the entities
+     * @param size the number of entities
+     * @param components the columns of components, one after the other
+     * @param columns the number of columns
+     * @param rows the rows in the column stores, laid out as the components
+     * (or null if no component type is stored in columns)
+     */
+    Chunk(const Entity *entities, std::size_t size, Component * const *components, std::size_t columns, const std::size_t *rows = nullptr)
+    : m_entities(entities), m_size(size), m_components(components), m_columns(columns), m_rows(rows) {
+    }
+
+    /**
+     * @brief Get the number of entities in the chunk.
+     *
+     * @returns the number of entities
+     */
+    std::size_t getSize() const {
+      return m_size;
+    }
+
+    /**
+     * @brief Get the entities of the chunk.
+     *
+     * @returns the entities
+     */
+    const Entity *getEntities() const {
+      return m_entities;
+    }
+
+    /**
+     * @brief Get an entity of the chunk.
+     *
+     * @param i the position of the entity (less than getSize())
+     * @returns the entity
+     */
+    Entity getEntityAt(std::size_t i) const {
+      assert(i < m_size);
+      return m_entities[i];
+    }
+
+    /**
+     * @brief Get the number of columns of the chunk.
+     *
+     * @returns the number of columns
+     */
+    std::size_t getColumnCount() const {
+      return m_columns;
+    }
+
+    /**
+     * @brief Get a column of components.
+     *
+     * @param column the column (less than getColumnCount())
+     * @returns the components of the entities
+     */
+    Component * const *getColumn(std::size_t column) const {
+      assert(column < m_columns);
+      return m_components + column * m_size;
+    }
+
+    /**
+     * @brief Get the component of an entity in a column.
+     *
+     * @param column the column (less than getColumnCount())
+     * @param i the position of the entity (less than getSize())
+     * @returns the component
+     */
+    template<typename C>
+    C *getComponentAt(std::size_t column, std::size_t i) const {
+      assert(i < m_size);
+      return static_cast<C *>(getColumn(column)[i]);
+    }
+
+    /**
+     * @brief Get the row of an entity in the column store of a column.
+     *
+     * @param column the column (less than getColumnCount())
+     * @param i the position of the entity (less than getSize())
+     * @returns the row of the entity in the column store or
+     * ColumnStoreBase::INVALID_ROW if the component type is not stored in
+     * columns
+     */
+    std::size_t getRowAt(std::size_t column, std::size_t i) const {
+      assert(column < m_columns);
+      assert(i < m_size);
+      return m_rows == nullptr ? ColumnStoreBase::INVALID_ROW : m_rows[column * m_size + i];
+    }
+
+  private:
+    const Entity *m_entities;
+    std::size_t m_size;
+    Component * const *m_components;
+    std::size_t m_columns;
+    const std::size_t *m_rows;
+  };
+
   /**
    * @brief A global system.
    *
@@ -39,13 +157,52 @@ namespace es {
      * system can easily access the manager)
      */
     GlobalSystem(int priority, std::set<ComponentType> needed, Manager *manager)
-      : System(priority, needed, manager)
+      : System(priority, needed, manager), m_iterating(false), m_parallel(false), m_grain(0), m_chunkSize(0), m_chunkTypes(needed.begin(), needed.end()), m_chunkHasColumns(false), m_fusable(false), m_filtered(false)
     {
     }
 
+    /**
+     * @brief Tell whether the entities are updated in parallel.
+     *
+     * @returns true if the parallel update is enabled
+     */
+    bool isParallel() const {
+      return m_parallel;
+    }
+
+    /**
+     * @brief Tell whether the system can be fused with other systems.
+     *
+     * A system with a change filter is never fused.
+     *
+     * @returns true if the system can be fused
+     */
+    bool isFusable() const {
+      return m_fusable && !m_filtered;
+    }
+
     virtual void update(float delta) override;
 
+    /**
+     * @brief Add an entity in the system.
+     *
+     * If the system is iterating over its entities, the addition is deferred
+     * until the end of the iteration.
+     *
+     * @param e the entity
+     * @returns true if the entity was not in the system
+     */
     virtual bool addEntity(Entity e) override;
+
+    /**
+     * @brief Remove an entity from the system.
+     *
+     * If the system is iterating over its entities, the removal is deferred
+     * until the end of the iteration.
+     *
+     * @param e the entity
+     * @returns true if the entity was in the system
+     */
     virtual bool removeEntity(Entity e) override;
 
     /**
@@ -58,7 +215,128 @@ namespace es {
      */
     virtual void updateEntity(float delta, Entity e);
 
+    /**
+     * @brief Update a chunk of entities in the current time step.
+     *
+     * This function is called by update when the chunk update is enabled
+     * (see @a enableChunkUpdate). By default, it calls updateEntity on each
+     * entity of the chunk.
+     *
+     * @param delta the time (in second) since the last update
+     * @param chunk the entities and their components
+     */
+    virtual void updateChunk(float delta, const Chunk& chunk);
+
+    /**
+     * @brief Get the column of a component type in the chunks.
+     *
+     * @param ct the component type (a needed component type)
+     * @returns the column of the component type
+     */
+    std::size_t getChunkColumn(ComponentType ct) const;
+
+    /**
+     * @brief Call a function on the entities handled by this system.
+     *
+     * The function is called with the entity and a reference to each
+     * component: `fn(Entity, C&...)`. The stores are resolved once, before
+     * the iteration. As in @a update, the entities that are added to or
+     * removed from the system during the iteration are handled at the end.
+     *
+     * @param fn the function
+     */
+    template<typename ... C, typename Fn>
+    void each(Fn fn) {
+      bool iterating = m_iterating;
+      m_iterating = true;
+      getManager()->each<C...>(m_entities, fn);
+      m_iterating = iterating;
+
+      if (!m_iterating) {
+        applyPending();
+      }
+    }
+
   protected:
+    /**
+     * @brief Enable the parallel update of the entities.
+     *
+     * A system should enable the parallel update only if updateEntity is
+     * safe to be called concurrently on different entities, i.e. it only
+     * modifies the components of its entity and it does not add or remove
+     * components or entities. Then, if the manager has worker threads, the
+     * entities are split in chunks of @a grain entities that are updated
+     * concurrently on the thread pool of the manager.
+     *
+     * @param grain the maximum number of entities in a chunk
+     */
+    void enableParallelUpdate(std::size_t grain = 256) {
+      m_parallel = true;
+      m_grain = grain;
+    }
+
+    /**
+     * @brief Enable the update of the entities by chunks.
+     *
+     * Then, @a update calls updateChunk on blocks of at most @a size
+     * entities, with the components of the needed component types already
+     * resolved. The components of the types that the system writes (all the
+     * needed types if the system has not declared its access, see
+     * System::declareAccess) are marked as modified. updateChunk must not
+     * remove components. The chunks are also used by the parallel update.
+     *
+     * @param size the maximum number of entities in a chunk
+     */
+    void enableChunkUpdate(std::size_t size = 64) {
+      assert(size > 0);
+      m_chunkSize = size;
+    }
+
+    /**
+     * @brief Allow the fusion of the system with other systems.
+     *
+     * When the fusion is enabled in the manager (see
+     * Manager::enableSystemFusion), adjacent fusable systems with the same
+     * needed component types and a declared access are updated in a single
+     * pass: the entities are split in chunks and each system updates a chunk
+     * (with updateChunk or updateEntity) before the next chunk, so that the
+     * components are still in the cache for the following systems. Hence,
+     * an entity is still updated by the systems in the order of their
+     * priority, but a system may update an entity before the previous system
+     * has updated all the entities. A system should enable the fusion only if
+     * its update of an entity only accesses the components of this entity.
+     * The single pass is only made when the systems have the same entities,
+     * otherwise they are updated one after the other.
+     */
+    void enableFusion() {
+      m_fusable = true;
+    }
+
+    /**
+     * @brief Only update the entities whose components have changed.
+     *
+     * Then, @a update only calls updateEntity on the entities that have at
+     * least one component of the given types that has been modified since
+     * the last update of the system (see System::getLastRunTick). The
+     * modifications are recorded by Manager::writeComponent,
+     * Manager::markChanged and the views with non-const component types.
+     *
+     * @param types the component types to watch
+     */
+    void enableChangeFilter(std::set<ComponentType> types) {
+      m_filtered = true;
+      m_filterTypes = types;
+    }
+
+    /**
+     * @brief Tell whether the components of an entity have changed.
+     *
+     * @param e the entity
+     * @returns true if a component of the change filter has been modified
+     * since the last update of the system, or if there is no change filter
+     */
+    bool hasChanged(Entity e) const;
+
     /**
      * @brief Get a copy of the entities handled by this system.
      *
@@ -69,8 +347,50 @@ namespace es {
     }
 
   private:
+    friend class Manager;
+
+    struct ChunkBuffer {
+      ChunkBuffer()
+      : busy(false) {
+      }
+
+      std::vector<Component *> components;
+      std::vector<std::size_t> rows;
+      bool busy;
+    };
+
+    void applyPending();
+    void resolveChunkStores();
+    void updateChunks(float delta, const std::vector<Entity>& entities, std::size_t begin, std::size_t end, ChunkBuffer& buffer);
+    void updateRange(float delta, const std::vector<Entity>& entities, std::size_t begin, std::size_t end, ChunkBuffer& buffer);
+    template<typename Fn>
+    void updateTask(Fn fn);
+    void updateFused(float delta, const std::vector<GlobalSystem *>& systems);
+
     std::set<Entity> m_entities;
 
+    bool m_iterating;
+    std::vector<std::pair<Entity, bool>> m_pending;
+
+    bool m_parallel;
+    std::size_t m_grain;
+    std::vector<Entity> m_snapshot;
+
+    std::size_t m_chunkSize;
+    std::vector<ComponentType> m_chunkTypes; // the needed types, in the order of the columns
+    bool m_chunkHasColumns;
+    std::vector<Store *> m_chunkStores;
+    std::vector<ColumnStoreBase *> m_chunkColumnStores;
+    std::vector<bool> m_chunkMarks;
+    ChunkBuffer m_chunkBuffer;
+    std::vector<ChunkBuffer> m_threadBuffers; // indexed by the index of the thread in the pool
+
+    bool m_fusable;
+
+    bool m_filtered;
+    std::set<ComponentType> m_filterTypes;
+    std::vector<Store *> m_filterStores;
+
   };
 
 
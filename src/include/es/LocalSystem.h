@@ -17,21 +17,84 @@
 #define ES_LOCAL_SYSTEM_H
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <es/Component.h>
 #include <es/System.h>
 #include <es/Entity.h>
 
 namespace es {
+  class ChangeList;
+  class Store;
+
+  /**
+   * @brief A contiguous range of entities.
+   */
+  class EntityRange {
+  public:
+    EntityRange(const Entity *first, const Entity *last)
+    : m_first(first), m_last(last) {
+    }
+
+    const Entity *begin() const {
+      return m_first;
+    }
+
+    const Entity *end() const {
+      return m_last;
+    }
+
+    std::size_t size() const {
+      return static_cast<std::size_t>(m_last - m_first);
+    }
+
+  private:
+    const Entity *m_first;
+    const Entity *m_last;
+  };
 
   /**
    * @brief A local system.
    *
    * A local system handles the entities in a rectangular grid and updates the
-   * entities that are in the focused cell.
+   * entities that are in the neighbourhood of one or several foci. The
+   * neighbourhood of a focus is the square of cells around the focus, within
+   * the radius of the focus. When the neighbourhoods overlap, the entities
+   * of a cell are updated only once.
+   *
+   * An entity is in at most one cell. The entities of all the cells are
+   * packed in a single array, sorted by cell (a counting sort), so that the
+   * entities of a cell are contiguous. The array is rebuilt lazily, before
+   * an update, when some entities have been added or removed. A moved entity
+   * is moved in place in the array, by swapping it across the boundaries
+   * of the cells between its old cell and its new cell.
+   *
+   * The grid is either dense, with fixed dimensions, or sparse. A sparse
+   * grid is not bounded: its cells are allocated when the first entity
+   * enters them and reclaimed when the last entity leaves them.
+   *
+   * The cells of the entities can be handled manually (see
+   * @a addLocalEntity and @a removeLocalEntity) or automatically, from a
+   * position component (see @a bindPosition).
    */
   class LocalSystem : public System {
   public:
+    /**
+     * @brief A function that gives the position of an entity from its
+     * position component.
+     *
+     * @param component the position component
+     * @param x the x coordinate of the position (output)
+     * @param y the y coordinate of the position (output)
+     */
+    typedef std::function<void(const Component *component, float& x, float& y)> PositionFunction;
 
     /**
      * @brief Create a local system.
@@ -46,13 +109,89 @@ namespace es {
      * @param height the height of the grid
      */
     LocalSystem(int priority, std::set<ComponentType> needed, Manager *manager, int width, int height)
-      : System(priority, needed, manager), m_width(width), m_height(height), m_x(0), m_y(0), m_entities(width * height)
+      : System(priority, needed, manager), m_sparse(false), m_width(width), m_height(height), m_foci(1, Focus{ 0, 0, 1 }), m_positionType(INVALID_COMPONENT), m_cellSize(1.0f), m_changes(nullptr), m_dirty(false), m_iterating(false), m_parallel(false), m_grain(0)
     {
       assert(width > 0);
       assert(height > 0);
     }
 
-    virtual void update(float delta);
+    /**
+     * @brief Create a local system with a sparse grid.
+     *
+     * The coordinates of the cells are not bounded.
+     *
+     * @param priority the priority of the system (small priority will
+     * be executed first)
+     * @param needed the set of needed component types that an entity must
+     * have to be handled properly by this system
+     * @param manager the manager (that is saved in the system so that the
+     * system can easily access the manager)
+     */
+    LocalSystem(int priority, std::set<ComponentType> needed, Manager *manager)
+      : System(priority, needed, manager), m_sparse(true), m_width(0), m_height(0), m_foci(1, Focus{ 0, 0, 1 }), m_positionType(INVALID_COMPONENT), m_cellSize(1.0f), m_changes(nullptr), m_dirty(false), m_iterating(false), m_parallel(false), m_grain(0)
+    {
+    }
+
+    /**
+     * @brief Tell whether the cells are updated in parallel.
+     *
+     * @returns true if the parallel update is enabled
+     */
+    bool isParallel() const {
+      return m_parallel;
+    }
+
+    /**
+     * @brief Tell whether the grid is sparse.
+     *
+     * @returns true if the grid is sparse
+     */
+    bool isSparse() const {
+      return m_sparse;
+    }
+
+    /**
+     * @brief Get the number of allocated cells.
+     *
+     * For a dense grid, this is the number of cells of the grid. For a
+     * sparse grid, this is the number of non-empty cells.
+     *
+     * @returns the number of cells
+     */
+    std::size_t getCellCount() const {
+      return m_sparse ? m_cellIds.size() : getIndex(0, m_height);
+    }
+
+    /**
+     * @brief Add an entity in the system.
+     *
+     * If a position component is bound, the entity is added in the cell of
+     * its position. Otherwise, nothing is done.
+     *
+     * @param e the entity
+     * @returns true if the entity was added
+     */
+    virtual bool addEntity(Entity e) override;
+
+    /**
+     * @brief Remove an entity from the system.
+     *
+     * The entity is removed from its cell.
+     *
+     * @param e the entity
+     * @returns true if the entity was removed
+     */
+    virtual bool removeEntity(Entity e) override;
+
+    /**
+     * @brief Update the entities in the neighbourhood of the focus.
+     *
+     * If a position component is bound, the entities are migrated first
+     * (see @a migrate).
+     *
+     * @param delta the time (in second) since the last update
+     */
+    virtual void update(float delta) override;
 
     /**
      * @brief Update an entity in the current time step.
@@ -67,29 +206,117 @@ namespace es {
     /**
      * @brief Reset the grid dimensions.
      *
+     * All the entities are removed from the grid and the grid becomes
+     * dense.
+     *
      * @param width the width of the grid
      * @param height the height of the grid
      */
     void reset(int width, int height);
 
     /**
-     * @brief Set the focus for local systems.
+     * @brief Reset the grid as a sparse grid.
+     *
+     * All the entities are removed from the grid.
+     */
+    void reset();
+
+    /**
+     * @brief Set a single focus with a radius of 1.
+     *
+     * The previous foci are removed.
      *
      * @param x the x-coordinate of the focus
      * @param y the y-coordinate of the focus
      */
     void setFocus(int x, int y) {
-      m_x = x;
-      m_y = y;
+      clearFoci();
+      addFocus(x, y, 1);
+    }
+
+    /**
+     * @brief Add a focus.
+     *
+     * The neighbourhood of the focus is made of the cells (x', y') with
+     * |x' - x| <= radius and |y' - y| <= radius.
+     *
+     * @param x the x-coordinate of the focus
+     * @param y the y-coordinate of the focus
+     * @param radius the radius of the neighbourhood (in cells)
+     */
+    void addFocus(int x, int y, int radius = 1) {
+      assert(radius >= 0);
+      m_foci.push_back({ x, y, radius });
     }
 
+    /**
+     * @brief Remove all the foci.
+     *
+     * Without any focus, no entity is updated.
+     */
+    void clearFoci() {
+      m_foci.clear();
+    }
+
+    /**
+     * @brief Get the number of foci.
+     *
+     * @returns the number of foci
+     */
+    std::size_t getFocusCount() const {
+      return m_foci.size();
+    }
+
+    /**
+     * @brief Bind a position component to the system.
+     *
+     * Then, the cell of an entity is computed from its position: the cell
+     * (x,y) contains the positions in [x * cellSize, (x + 1) * cellSize[ ×
+     * [y * cellSize, (y + 1) * cellSize[. For a dense grid, the positions
+     * outside the grid are in the border cells.
+     *
+     * @param ct the position component type
+     * @param cellSize the size of a cell
+     * @param position the function that gives the position from the component
+     */
+    void bindPosition(ComponentType ct, float cellSize, PositionFunction position);
+
+    /**
+     * @brief Bind a position component to the system.
+     *
+     * The function is called as `fn(const C&, float& x, float& y)`.
+     *
+     * @param cellSize the size of a cell
+     * @param fn the function that gives the position from the component
+     */
+    template<typename C, typename Fn>
+    void bindPosition(float cellSize, Fn fn) {
+      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
+      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+      bindPosition(C::type, cellSize, [fn](const Component *c, float& x, float& y) {
+        fn(*static_cast<const C *>(c), x, y);
+      });
+    }
+
+    /**
+     * @brief Move the entities whose position has changed to their new cell.
+     *
+     * Only the entities whose position component has been modified since
+     * the last migration are checked (see Store::createChangeList), and only
+     * the entities whose cell has changed are moved. This function is called
+     * automatically by @a update.
+     */
+    void migrate();
+
     /**
      * @brief Add an entity in the (x,y) cell of the grid.
      *
+     * If the entity is already in another cell, it is moved to this cell.
+     *
      * @param e the entity
      * @param x the x coordinate
      * @param y the y coordinate
-     * @returns true if the entity was added
+     * @returns true if the entity was not already in this cell
      */
     bool addLocalEntity(Entity e, int x, int y);
 
@@ -99,27 +326,142 @@ namespace es {
      * @param e the entity
      * @param x the x coordinate
      * @param y the y coordinate
-     * @returns true if the entity was added
+     * @returns true if the entity was in this cell and has been removed
      */
     bool removeLocalEntity(Entity e, int x, int y);
 
   protected:
+    /**
+     * @brief Enable the parallel update of the cells.
+     *
+     * The active cells are split in 9 phases, according to their coordinates
+     * modulo 3. The phases are run one after the other, and the cells of a
+     * phase are updated concurrently on the thread pool of the manager, in
+     * chunks of at most @a grain cells. Two cells of the same phase are at
+     * least 3 cells apart, so their neighbourhoods do not overlap:
+     * updateEntity may read and modify the entities of the cell of the entity
+     * and of the adjacent cells. It must not add, remove or move entities,
+     * nor add or remove components.
+     *
+     * If the manager has no worker threads, the update is sequential.
+     *
+     * @param grain the maximum number of cells in a chunk
+     */
+    void enableParallelUpdate(std::size_t grain = 4) {
+      assert(grain > 0);
+      m_parallel = true;
+      m_grain = grain;
+    }
+
+    /**
+     * @brief Get the entities in the neighbourhood of the foci.
+     *
+     * This function checks all the entities of the system and allocates a
+     * new set, prefer @a getRanges.
+     *
+     * @returns a copy of the entities
+     */
     const std::set<Entity> getEntities() const;
 
+    /**
+     * @brief Get the ranges of entities in the neighbourhood of the foci.
+     *
+     * The ranges are disjoint, and adjacent cells are merged in a single
+     * range, so that each entity appears exactly once. The ranges are valid
+     * until the next entity is added, removed or moved.
+     *
+     * @returns the ranges of entities
+     */
+    const std::vector<EntityRange>& getRanges();
+
   private:
-    int getIndex(int x, int y) const {
-      return y * m_width + x;
+    struct Focus {
+      int x;
+      int y;
+      int radius;
+    };
+
+    std::size_t getIndex(int x, int y) const {
+      return static_cast<std::size_t>(y) * static_cast<std::size_t>(m_width) + static_cast<std::size_t>(x);
     }
 
+    static uint64_t getKey(int x, int y) {
+      return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    std::size_t findCell(int x, int y) const;
+    std::size_t acquireCell(int x, int y);
+    void releaseCell(std::size_t cell);
+    void clear();
+
+    void addRange(std::size_t first, std::size_t last);
+    void addSpan(std::size_t first, std::size_t last);
+    void addSparseSpans(const Focus& focus);
+    void rebuild();
+    void computeRanges();
+
+    void getCellCoordinates(std::size_t cell, int64_t& x, int64_t& y) const;
+    std::size_t getPhase(std::size_t cell) const;
+    void updateParallel(float delta);
+
+    struct Member {
+      Entity entity;
+      std::size_t cell;
+      std::size_t slot; // in the packed array
+    };
+
+    std::size_t findMember(Entity e) const;
+    void eraseMember(std::size_t position);
+    void migrateMember(Store *store, std::size_t position, std::size_t& budget);
+    void moveMember(std::size_t position, std::size_t cell, std::size_t& budget);
+    void swapSlots(std::size_t first, std::size_t second);
+
+    void computeCell(const Component *c, int& x, int& y) const;
+    int computeCellCoordinate(float position, int size) const;
+
+    static const std::size_t INVALID_POSITION = static_cast<std::size_t>(-1);
+
+    bool m_sparse;
     int m_width;
     int m_height;
 
-    int m_x;
-    int m_y;
+    // the cells of a sparse grid, with a compact id
+    std::unordered_map<uint64_t, std::size_t> m_cellIds;
+    std::vector<std::size_t> m_cellCounts;
+    std::vector<uint64_t> m_cellKeys;
+    std::vector<std::size_t> m_freeCells;
+
+    std::vector<Focus> m_foci;
+
+    // the cell of each entity, with a sparse index by entity index
+    std::vector<Member> m_members;
+    std::vector<std::size_t> m_positions;
+
+    // the position component
+    ComponentType m_positionType;
+    float m_cellSize;
+    PositionFunction m_position;
+    ChangeList *m_changes;
+
+    // the entities sorted by cell
+    bool m_dirty;
+    bool m_iterating;
+    std::vector<std::size_t> m_offsets;
+    std::vector<std::size_t> m_cursors;
+    std::vector<Entity> m_packed;
+    std::vector<EntityRange> m_ranges;
+
+    // the spans of active cells, as pairs of cell ids [first, last]
+    std::vector<std::pair<std::size_t, std::size_t>> m_spans;
+
+    // the parallel update, with the active cells of each phase
+    static const std::size_t PHASE_COUNT = 9;
 
-    std::vector<std::set<Entity>> m_entities;
+    bool m_parallel;
+    std::size_t m_grain;
+    std::vector<std::size_t> m_phases[PHASE_COUNT];
   };
 
 }
 
-#endif // ES_GLOBAL_SYSTEM_H
+#endif // ES_LOCAL_SYSTEM_H
@@ -16,20 +16,35 @@
 #ifndef ES_MANAGER_H
 #define ES_MANAGER_H
 
-#include <map>
+#include <atomic>
+#include <cassert>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
 #include <vector>
 
+#include <es/Archetype.h>
+#include <es/ColumnStore.h>
+#include <es/CommandBuffer.h>
+#include <es/ComponentObserver.h>
 #include <es/Entity.h>
 #include <es/Event.h>
+#include <es/EventDelegate.h>
 #include <es/EventHandler.h>
+#include <es/EventQueue.h>
+#include <es/Pool.h>
+#include <es/Registry.h>
 #include <es/Store.h>
 #include <es/System.h>
+#include <es/ThreadPool.h>
+#include <es/View.h>
 
 namespace es {
+  class GlobalSystem;
 
   /**
    * @brief The manager.
@@ -44,7 +59,7 @@ namespace es {
      * @brief Create a manager.
      */
     Manager()
-    : m_next(1) { }
+    : m_entities(1), m_nextIndex(1), m_tick(1), m_commands(this), m_systemsVersion(1), m_scheduleNeeded(false), m_fusionEnabled(false), m_concurrentUpdate(false), m_stores(MAX_COMPONENT_TYPES, nullptr), m_columnStores(MAX_COMPONENT_TYPES, nullptr), m_archetypesEnabled(false), m_dispatchDepth(0), m_handlersDirty(false), m_queueTable(nullptr), m_observersDispatching(false) { }
 
     ~Manager();
 
@@ -60,11 +75,31 @@ namespace es {
     /**
      * @brief Destroy an entity.
      *
+     * The entity is removed from the stores and from the systems. The
+     * components that are owned by a store are destroyed. The index of the
+     * entity is then recycled for a future entity.
+     *
      * @param e the entity to destroy
      * @returns true if the entity was actually present and destroyed
      */
     bool destroyEntity(Entity e);
 
+    /**
+     * @brief Tell whether an entity is alive.
+     *
+     * An entity is alive if it has been created by this manager and has not
+     * been destroyed yet. A stale handle is never alive.
+     *
+     * @param e the entity
+     * @returns true if the entity is alive
+     */
+    bool isAlive(Entity e) const {
+      uint32_t index = getEntityIndex(e);
+      return index != 0 && index < m_entities.size()
+          && m_entities[index].alive
+          && m_entities[index].generation == getEntityGeneration(e);
+    }
+
     /**
      * @brief Get all the entities
      *
@@ -77,6 +112,46 @@ namespace es {
 
     /// @{
 
+    /**
+     * @brief Register a component type in the component registry.
+     *
+     * A component type is registered automatically when its store is
+     * created. Registering it with a name makes it possible to detect a
+     * collision of the hashes of two component types.
+     *
+     * @param ct a component type
+     * @param name the name of the component type or null if it is unknown
+     * @returns true if the component type is registered
+     */
+    bool registerComponent(ComponentType ct, const char *name = nullptr);
+
+    /**
+     * @brief Register a component type in the component registry.
+     *
+     * @returns true if the component type is registered
+     */
+    template<typename C>
+    bool registerComponent() {
+      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
+      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+      return getComponentIndex<C>() != INVALID_TYPE_INDEX;
+    }
+
+    /**
+     * @brief Get the index of a component type in the component registry.
+     *
+     * The index is computed once per type and then cached, so that the
+     * templated functions of the manager access their store directly.
+     *
+     * @returns the index of the component type or INVALID_TYPE_INDEX
+     */
+    template<typename C>
+    static std::size_t getComponentIndex() {
+      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
+      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+      return Registry::getComponentIndex<C>();
+    }
+
     /**
      * @brief Get the store associated to a component type.
      *
@@ -85,6 +160,24 @@ namespace es {
      */
     Store *getStore(ComponentType ct);
 
+    /**
+     * @brief Get the store associated to a component type.
+     *
+     * @returns the store or nullptr if the store does not exist
+     */
+    template<typename C>
+    Store *getStore() {
+      return getStoreAt(getComponentIndex<C>());
+    }
+
+    /**
+     * @brief Get the column store associated to a component type.
+     *
+     * @param ct a component type
+     * @returns the column store or nullptr if the store does not exist
+     */
+    ColumnStoreBase *getColumnStore(ComponentType ct);
+
     /**
      * @brief Create a store for a component type.
      *
@@ -102,9 +195,131 @@ namespace es {
     bool createStoreFor() {
       static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
       static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+
+      if (!registerComponent<C>()) {
+        return false;
+      }
+
       return createStoreFor(C::type);
     }
 
+    /**
+     * @brief Create a store that owns its components for a component type.
+     *
+     * @param ct a component type
+     * @param pool the pool of the components (the manager takes the ownership)
+     * @returns true if the store was created
+     */
+    bool createStoreFor(ComponentType ct, Pool *pool);
+
+    /**
+     * @brief Create a store that owns its components for a component type.
+     *
+     * The components of this type are then stored by value in a pool and must
+     * be created with @a emplaceComponent.
+     *
+     * @param chunkSize the number of components in a chunk of the pool
+     * @returns true if the store was created
+     */
+    template<typename C>
+    bool createPooledStoreFor(std::size_t chunkSize = 256) {
+      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
+      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+
+      if (!registerComponent<C>()) {
+        return false;
+      }
+
+      ComponentPool<C> *pool = new ComponentPool<C>(chunkSize);
+
+      if (!createStoreFor(C::type, pool)) {
+        delete pool;
+        return false;
+      }
+
+      return true;
+    }
+
+    /**
+     * @brief Create a column store for a component type.
+     *
+     * The component type declares its fields with a `Columns` typedef (see
+     * ColumnStore). The fields of the entities are then kept in aligned
+     * columns, one for each field, and they are added with
+     * @a addColumnComponent. A component type has either a store or a
+     * column store. The components stored in columns are not part of the
+     * archetypes (see @a enableArchetypes).
+     *
+     * @returns the column store or nullptr if the store was not created
+     */
+    template<typename C>
+    typename C::Columns *createColumnStoreFor() {
+      std::size_t index = getComponentIndex<C>();
+
+      if (index == INVALID_TYPE_INDEX) {
+        return nullptr;
+      }
+
+      typename C::Columns *store = new typename C::Columns;
+
+      if (!createColumnStoreAt(index, store)) {
+        delete store;
+        return nullptr;
+      }
+
+      return store;
+    }
+
+    /**
+     * @brief Get the column store of a component type.
+     *
+     * The columns can be iterated directly, for example in a vectorized
+     * kernel. The entities must not be added or removed during the
+     * iteration.
+     *
+     * @returns the column store or nullptr if the store does not exist
+     */
+    template<typename C>
+    typename C::Columns *getColumnStore() {
+      return static_cast<typename C::Columns *>(getColumnStoreAt(getComponentIndex<C>()));
+    }
+
+    /**
+     * @brief Add a component that is stored in columns to an entity.
+     *
+     * @param e the entity
+     * @param values the values of the fields of the component
+     * @returns true if the component was added
+     */
+    template<typename C, typename ... Values>
+    bool addColumnComponent(Entity e, Values&&... values) {
+      assert(!m_concurrentUpdate);
+      std::size_t index = getComponentIndex<C>();
+      typename C::Columns *store = static_cast<typename C::Columns *>(getColumnStoreAt(index));
+
+      if (store == nullptr || getEntityData(e) == nullptr) {
+        return false;
+      }
+
+      if (!store->add(e, std::forward<Values>(values)...)) {
+        return false;
+      }
+
+      attachColumnComponentAt(e, index);
+      return true;
+    }
+
+    /**
+     * @brief Remove a component that is stored in columns from an entity.
+     *
+     * @param e the entity
+     * @returns true if the component was removed
+     */
+    template<typename C>
+    bool removeColumnComponent(Entity e) {
+      return removeColumnComponentAt(e, getComponentIndex<C>());
+    }
+
     /// @}
 
 
@@ -129,14 +344,68 @@ namespace es {
      */
     template<typename C>
     C *getComponent(Entity e) {
-      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
-      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
-      return static_cast<C*>(getComponent(e, C::type));
+      Store *store = getStore<C>();
+      return store == nullptr ? nullptr : static_cast<C*>(store->get(e));
+    }
+
+    /**
+     * @brief Get the component associated to an entity for writing.
+     *
+     * The component is marked as changed (see @a markChanged). Contrary to
+     * @a getComponent and @a readComponent, this must be used when the
+     * component is modified, so that the change filters and the observers
+     * see the modification.
+     *
+     * @param e the entity
+     * @param ct the component type
+     * @returns the component or null if the entity is not valid, or if the
+     *   store does not exist or if the entity has no component of this type
+     */
+    Component *writeComponent(Entity e, ComponentType ct);
+
+    /**
+     * @brief Get the component associated to an entity for writing.
+     *
+     * @param e the entity
+     * @returns the component or null if the entity is not valid, or if the
+     *   store does not exist or if the entity has no component of this type
+     */
+    template<typename C>
+    C *writeComponent(Entity e) {
+      return static_cast<C*>(writeComponentAt(e, getComponentIndex<C>()));
+    }
+
+    /**
+     * @brief Get the component associated to an entity for reading.
+     *
+     * As with @a getComponent, the component is not marked as modified.
+     *
+     * @param e the entity
+     * @param ct the component type
+     * @returns the component or null if the entity is not valid, or if the
+     *   store does not exist or if the entity has no component of this type
+     */
+    const Component *readComponent(Entity e, ComponentType ct);
+
+    /**
+     * @brief Get the component associated to an entity for reading.
+     *
+     * @param e the entity
+     * @returns the component or null if the entity is not valid, or if the
+     *   store does not exist or if the entity has no component of this type
+     */
+    template<typename C>
+    const C *readComponent(Entity e) {
+      Store *store = getStore<C>();
+      return store == nullptr ? nullptr : static_cast<const C*>(store->read(e));
     }
 
     /**
      * @brief Add a component to an entity.
      *
+     * If the store owns its components, the component must have been created
+     * by the pool of the store (see @a emplaceComponent).
+     *
      * @param e the entity
      * @param ct the component type
      * @param c the component to be added
@@ -153,39 +422,241 @@ namespace es {
      */
     template<typename C>
     bool addComponent(Entity e, C *c) {
-      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
-      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
-      return addComponent(e, C::type, c);
+      return addComponentAt(e, getComponentIndex<C>(), c, &CommandBuffer::deleteComponent<C>);
+    }
+
+    /**
+     * @brief Create a component in place and add it to an entity.
+     *
+     * The store of the component type must have been created with
+     * @a createPooledStoreFor.
+     *
+     * @param e the entity
+     * @param args the arguments to pass to the component's constructor
+     * @returns the component or null if the component was not added
+     */
+    template<typename C, typename ... Args>
+    C *emplaceComponent(Entity e, Args&&... args) {
+      assert(!m_concurrentUpdate);
+      std::size_t index = getComponentIndex<C>();
+      Store *store = getStoreAt(index);
+
+      if (store == nullptr || !store->ownsComponents()) {
+        return nullptr;
+      }
+
+      ComponentPool<C> *pool = static_cast<ComponentPool<C> *>(store->getPool());
+      C *c = pool->create(std::forward<Args>(args)...);
+
+      if (!addComponentAt(e, index, c)) {
+        pool->destroy(c);
+        return nullptr;
+      }
+
+      return c;
     }
 
     /**
      * @brief Extract the component associated to an entity.
      *
-     * The component is removed from the associated store and returned.
+     * The component is removed from the associated store and returned. The
+     * caller is then responsible for deleting the component. A component
+     * can not be extracted from a store that owns its components (see
+     * createPooledStoreFor), use @a destroyComponent instead.
      *
      * @param e the entity
      * @param ct the component type
      * @returns the component or null if the entity is not valid, or if the
-     *   store does not exist or if the entity has no component of this type
+     *   store does not exist or owns its components, or if the entity has no
+     *   component of this type
      */
     Component *extractComponent(Entity e, ComponentType ct);
 
     /**
      * @brief Extract the component associated to an entity.
      *
-     * The component is removed from the associated store and returned.
+     * The component is removed from the associated store and returned. The
+     * caller is then responsible for deleting the component. A component
+     * can not be extracted from a store that owns its components (see
+     * createPooledStoreFor), use @a destroyComponent instead.
      *
      * @param e the entity
      * @returns the component or null if the entity is not valid, or if the
-     *   store does not exist or if the entity has no component of this type
+     *   store does not exist or owns its components, or if the entity has no
+     *   component of this type
      */
     template<typename C>
     C *extractComponent(Entity e) {
-      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
-      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
-      return static_cast<C*>(extractComponent(e, C::type));
+      return static_cast<C*>(extractComponentAt(e, getComponentIndex<C>()));
+    }
+
+    /**
+     * @brief Remove the component associated to an entity and destroy it.
+     *
+     * This only works if the store owns its components.
+     *
+     * @param e the entity
+     * @param ct the component type
+     * @returns true if the component was actually removed and destroyed
+     */
+    bool destroyComponent(Entity e, ComponentType ct);
+
+    /**
+     * @brief Remove the component associated to an entity and destroy it.
+     *
+     * This only works if the store owns its components.
+     *
+     * @param e the entity
+     * @returns true if the component was actually removed and destroyed
+     */
+    template<typename C>
+    bool destroyComponent(Entity e) {
+      return destroyComponentAt(e, getComponentIndex<C>());
+    }
+
+    /**
+     * @brief Mark the component associated to an entity as changed.
+     *
+     * The component is marked as modified in its store and the observers of
+     * the CHANGED event of the component type are notified at the next
+     * synchronization point. This function can be called while the systems
+     * are updated concurrently.
+     *
+     * @param e the entity
+     * @param ct the component type
+     */
+    void markChanged(Entity e, ComponentType ct);
+
+    /**
+     * @brief Mark the component associated to an entity as changed.
+     *
+     * @param e the entity
+     */
+    template<typename C>
+    void markChanged(Entity e) {
+      markChangedAt(e, getComponentIndex<C>());
+    }
+
+    /**
+     * @brief Register an observer to the changes of a component type.
+     *
+     * The changes are recorded by @a addComponent, @a extractComponent,
+     * @a destroyComponent, @a destroyEntity and @a markChanged. They are
+     * delivered to the observer in a batch at the next synchronization point
+     * (see @a synchronize). An observer registered by another observer
+     * during a dispatch is only notified from the next synchronization
+     * point.
+     *
+     * @param ct the component type
+     * @param event the kind of change to observe
+     * @param observer the component observer
+     */
+    void registerObserver(ComponentType ct, ComponentEvent event, ComponentObserver observer);
+
+    /**
+     * @brief Register an observer to the changes of a component type.
+     *
+     * @param event the kind of change to observe
+     * @param observer the component observer
+     */
+    template<typename C>
+    void registerObserver(ComponentEvent event, ComponentObserver observer) {
+      registerObserverAt(getComponentIndex<C>(), event, observer);
+    }
+
+    /// @}
+
+
+    /// @{
+
+    /**
+     * @brief Enable the archetype storage.
+     *
+     * In addition to the stores, the manager then groups the entities that
+     * have the same components in archetype tables. The stores are still
+     * used to access a single component of an entity, while the archetypes
+     * can be used to iterate over all the entities that have some given
+     * components. The tables are kept up to date when components are added
+     * or removed, which makes these operations a bit more expensive. The
+     * tables hold pointers to the components of the stores, not the
+     * components themselves (see Archetype).
+     *
+     * The existing entities are put in their archetype when the storage is
+     * enabled.
+     */
+    void enableArchetypes();
+
+    /**
+     * @brief Tell whether the archetype storage is enabled.
+     *
+     * @returns true if the archetype storage is enabled
+     */
+    bool hasArchetypes() const {
+      return m_archetypesEnabled;
     }
 
+    /**
+     * @brief Get the archetypes that contain some component types.
+     *
+     * Only non-empty archetypes are returned.
+     *
+     * @param needed the set of component types
+     * @returns the archetypes whose signature contains the component types
+     */
+    std::vector<Archetype *> getArchetypes(const std::set<ComponentType>& needed);
+
+    /// @}
+
+
+    /// @{
+
+    /**
+     * @brief Get a view on the entities that have some components.
+     *
+     * @returns a view on the stores of the component types
+     */
+    template<typename ... C>
+    View<C...> getView() {
+      return View<C...>(this, getStore<C>()...);
+    }
+
+    /**
+     * @brief Call a function on all the entities that have some components.
+     *
+     * The function is called with the entity and a reference to each
+     * component: `fn(Entity, C&...)`. If the archetype storage is enabled,
+     * the matching archetypes are walked. Otherwise, the smallest store is
+     * walked and the other components are taken directly in their store.
+     *
+     * The function must not add or remove components.
+     *
+     * @param fn the function
+     */
+    template<typename ... C, typename Fn>
+    void each(Fn fn) {
+      View<C...> view = getView<C...>();
+
+      if (m_archetypesEnabled) {
+        view.each(getArchetypes({ C::type... }), fn);
+      } else {
+        view.each(fn);
+      }
+    }
+
+    /**
+     * @brief Call a function on some entities that have some components.
+     *
+     * The function is called with the entity and a reference to each
+     * component: `fn(Entity, C&...)`. The entities that do not have all the
+     * components are skipped.
+     *
+     * @param entities the entities (for instance, the entities of a system)
+     * @param fn the function
+     */
+    template<typename ... C, typename Range, typename Fn>
+    void each(const Range& entities, Fn fn) {
+      getView<C...>().each(entities, fn);
+    }
 
     /// @}
 
@@ -206,7 +677,9 @@ namespace es {
      * @brief Subscribe and entity to the systems.
      *
      * The manager uses the component types of the components that have been
-     * added to the entity.
+     * added to the entity. The matching systems are cached per signature, so
+     * that subscribing an entity again only adds it to the systems it now
+     * matches and removes it from the systems it does not match anymore.
      *
      * @param e the entity
      * @returns the number of systems the entity was subscribed
@@ -237,16 +710,113 @@ namespace es {
 
     /**
      * @brief Initialize all systems.
+     *
+     * The systems are sorted by priority and the dependencies between the
+     * systems are computed from their declared access to components.
      */
     void initSystems();
 
+    /**
+     * @brief Set the number of worker threads used to update the systems.
+     *
+     * With at least one worker thread, the systems with the same priority
+     * that do not conflict are updated concurrently. Two systems conflict if
+     * one of them writes a component type that the other one reads or
+     * writes, or if one of them has not declared its access. Conflicting
+     * systems keep the order of the sequential update, and a system starts
+     * only after all the systems with a smaller priority are finished. Each
+     * phase (preUpdate, update, postUpdate) is finished for all the systems
+     * before the next phase.
+     *
+     * While the systems are updated concurrently, the structural changes
+     * made through the manager (@a createEntity, @a destroyEntity,
+     * @a addComponent, @a destroyComponent and @a subscribeEntityToSystems)
+     * are recorded in the command buffer and applied at the next
+     * synchronization point (see CommandBuffer), and the other structural
+     * changes (@a emplaceComponent, @a extractComponent, the column
+     * components) must not be made. The events must be queued with
+     * @a queueEvent instead of being triggered.
+     *
+     * By default, there is no worker thread and the systems are updated
+     * sequentially.
+     *
+     * @param count the number of worker threads
+     */
+    void setThreadCount(unsigned count);
+
+    /**
+     * @brief Enable the fusion of systems.
+     *
+     * Then, the adjacent global systems (in the order of priority) that
+     * allow the fusion (see GlobalSystem::enableFusion), that have the same
+     * needed component types, that have declared their access and that do
+     * not conflict (see @a setThreadCount) are updated in a single pass over
+     * their entities. A group of fused systems is scheduled as a single
+     * system. The groups are computed in @a initSystems. If the systems of a
+     * group do not have the same entities at the time of an update, they are
+     * updated one after the other.
+     */
+    void enableSystemFusion() {
+      m_fusionEnabled = true;
+      m_scheduleNeeded = true;
+    }
+
+    /**
+     * @brief Get the current tick of the manager.
+     *
+     * The tick is used to record the modifications of the components in the
+     * stores. It is advanced after each system is updated, so that a system
+     * can find the components that have been modified since its last
+     * update (see System::getLastRunTick).
+     *
+     * @returns the current tick
+     */
+    uint64_t getTick() const {
+      return m_tick.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the thread pool of the manager.
+     *
+     * @returns the thread pool or null if there is no worker thread
+     */
+    ThreadPool *getThreadPool() {
+      return m_threadPool.get();
+    }
+
     /**
      * @brief Update all systems.
      *
+     * The manager is synchronized after each phase (preUpdate, update,
+     * postUpdate).
+     *
      * @param delta the time (in second) since the last update
      */
     void updateSystems(float delta);
 
+    /**
+     * @brief Get the command buffer of the manager.
+     *
+     * The structural changes that are recorded in this buffer during the
+     * update of the systems are applied at the next synchronization point.
+     *
+     * @returns the command buffer
+     */
+    CommandBuffer& getCommandBuffer() {
+      return m_commands;
+    }
+
+    /**
+     * @brief Synchronize the manager.
+     *
+     * The commands of the command buffer are applied and then, the changes
+     * of the components are delivered to their observers and the queued
+     * events are dispatched to their handlers. This function is
+     * called automatically by @a updateSystems and must not be called while a
+     * system is updated.
+     */
+    void synchronize();
+
     /// @}
 
 
@@ -255,6 +825,9 @@ namespace es {
     /**
      * @brief Register an event handler to an event type.
      *
+     * If an event is being dispatched, the handler is registered at the end
+     * of the dispatch.
+     *
      * @param type an event type
      * @param handler the event handler
      */
@@ -267,9 +840,23 @@ namespace es {
      */
     template<typename E>
     void registerHandler(EventHandler handler) {
+      registerHandlerAt(getEventIndex<E>(), handler);
+    }
+
+    /**
+     * @brief Get the index of an event type in the event registry.
+     *
+     * The index is computed once per type and then cached, so that the
+     * templated functions of the manager access the handlers of the event
+     * type directly.
+     *
+     * @returns the index of the event type or INVALID_TYPE_INDEX
+     */
+    template<typename E>
+    static std::size_t getEventIndex() {
       static_assert(std::is_base_of<Event, E>::value, "E must be an Event");
       static_assert(E::type != INVALID_EVENT, "E must define its type");
-      registerHandler(E::type, handler);
+      return Registry::getEventIndex<E>();
     }
 
     /**
@@ -291,10 +878,61 @@ namespace es {
           std::bind(pm, obj, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     }
 
+    /**
+     * @brief Register a typed event handler.
+     *
+     * The handler is any callable object with the signature
+     * `EventStatus(Entity, const E&)`. It is stored as a delegate in a flat
+     * array of the event type: a handler without state is stored as a
+     * function pointer, otherwise it is copied once, at registration.
+     *
+     * The typed handlers of an event type are called before the generic
+     * handlers (see EventHandler).
+     *
+     * @param fn the handler
+     */
+    template<typename E, typename F>
+    typename std::enable_if<IsEventDelegateCallable<F, E>::value>::type registerHandler(F fn) {
+      static_assert(std::is_base_of<Event, E>::value, "E must be an Event");
+      static_assert(E::type != INVALID_EVENT, "E must define its type");
+      TypedHandlerList<E> *list = getHandlerList<E>();
+
+      if (list != nullptr) {
+        list->addCallable(std::move(fn));
+      }
+    }
+
+    /**
+     * @brief Register a method as a typed event handler.
+     *
+     * The method has the signature `EventStatus(Entity, const E&)` and is
+     * called directly on the object, without any binding:
+     *
+     * ~~~{.cc}
+     * manager->registerHandler<Collision, Sound, &Sound::onCollision>(sound);
+     * ~~~
+     *
+     * @param obj the object on which to call the method (that must outlive
+     * the handler)
+     */
+    template<typename E, typename T, EventStatus (T::*Method)(Entity, const E&)>
+    void registerHandler(T *obj) {
+      static_assert(std::is_base_of<Event, E>::value, "E must be an Event");
+      static_assert(E::type != INVALID_EVENT, "E must define its type");
+      assert(obj);
+      TypedHandlerList<E> *list = getHandlerList<E>();
+
+      if (list != nullptr) {
+        list->add(EventDelegate<E>::template fromMethod<T, Method>(obj));
+      }
+    }
+
     /**
      * @brief Trigger an event.
      *
-     * The event is dispatched to registered handlers.
+     * The event is dispatched to registered handlers. This function must not
+     * be called by the systems that are updated concurrently (see
+     * @a setThreadCount): they must use @a queueEvent instead.
      *
      * @param origin the entity that triggers the event
      * @param type the event type
@@ -305,7 +943,9 @@ namespace es {
     /**
      * @brief Trigger an event.
      *
-     * The event is dispatched to registered handlers.
+     * The event is dispatched to registered handlers. This function must not
+     * be called by the systems that are updated concurrently (see
+     * @a setThreadCount): they must use @a queueEvent instead.
      *
      * @param origin the entity that triggers the event
      * @param event the event parameters
@@ -314,18 +954,234 @@ namespace es {
     void triggerEvent(Entity origin, E *event) {
       static_assert(std::is_base_of<Event, E>::value, "E must be an Event");
       static_assert(E::type != INVALID_EVENT, "E must define its type");
-      triggerEvent(origin, E::type, event);
+      assert(!m_concurrentUpdate);
+      EventData *data = findEventData(getEventIndex<E>());
+
+      if (data == nullptr) {
+        return;
+      }
+
+      if (data->list) {
+        static_cast<TypedHandlerList<E> *>(data->list.get())->dispatch(origin, *event);
+      }
+
+      dispatchEvent(origin, data->type, event, data->handlers);
+    }
+
+    /**
+     * @brief Queue an event.
+     *
+     * The event is copied in the queue of its type and dispatched to the
+     * registered handlers at the next synchronization point (see
+     * @a synchronize), with all the other events of the same type. The
+     * events queued by the handlers during the dispatch are dispatched at
+     * the following synchronization point. This function can be called
+     * concurrently from several threads.
+     *
+     * @param origin the entity that triggers the event
+     * @param event the event parameters
+     */
+    template<typename E>
+    void queueEvent(Entity origin, const E& event) {
+      static_assert(std::is_base_of<Event, E>::value, "E must be an Event");
+      static_assert(E::type != INVALID_EVENT, "E must define its type");
+      std::size_t index = getEventIndex<E>();
+
+      if (index == INVALID_TYPE_INDEX) {
+        return;
+      }
+
+      EventQueue *queue = findEventQueue(index);
+
+      // the global lock is only taken the first time an event type is queued
+      if (queue == nullptr) {
+        std::lock_guard<std::mutex> lock(m_queuesMutex);
+        queue = findEventQueue(index);
+
+        if (queue == nullptr) {
+          queue = new TypedEventQueue<E>;
+          addEventQueue(index, queue);
+        }
+      }
+
+      static_cast<TypedEventQueue<E> *>(queue)->push(origin, event);
     }
 
     /// @}
 
   private:
-    Entity m_next;
+    friend class CommandBuffer;
+
+    Entity reserveEntity();
+    void createReservedEntity(Entity e);
+
+    struct EntityData {
+      EntityData()
+      : generation(0), alive(false), archetype(nullptr), row(0), subscriptionVersion(0) { }
+
+      uint32_t generation;
+      bool alive;
+      ComponentSignature signature;
+      Archetype *archetype;
+      std::size_t row;
+
+      // the signature of the last subscription to the systems
+      ComponentSignature subscription;
+      unsigned subscriptionVersion;
+    };
+
+    struct SystemData {
+      std::shared_ptr<System> system;
+      ComponentSignature needed;
+
+      // fusion: the systems of the group (on the first system of the group)
+      GlobalSystem *global;
+      std::vector<GlobalSystem *> fused;
+      bool follower;
+
+      // schedule
+      bool declared;
+      ComponentSignature reads;
+      ComponentSignature writes;
+      std::size_t predecessors;
+      std::vector<std::size_t> successors;
+    };
+
+    static bool conflicts(const SystemData& lhs, const SystemData& rhs);
+    void computeSchedule();
+    void computeFusion();
+    void runSystems(void (System::*phase)(float), float delta, bool record);
+    void runSystem(SystemData& sys, void (System::*phase)(float), float delta, bool record);
+
+    static ComponentSignature getSignature(const std::set<ComponentType>& components);
+    const std::vector<std::size_t>& getMatchingSystems(const ComponentSignature& signature);
+    int subscribe(Entity e, const ComponentSignature& signature, EntityData *data);
+    void invalidateSubscriptions();
+
+    struct ObserverData {
+      std::vector<ComponentObserver> observers[3];
+      std::vector<Entity> pending[3];
+    };
+
+    struct PendingObserver {
+      std::size_t index;
+      ComponentEvent event;
+      ComponentObserver observer;
+    };
+
+    Store *getStoreAt(std::size_t index) {
+      return index < m_stores.size() ? m_stores[index] : nullptr;
+    }
+
+    ColumnStoreBase *getColumnStoreAt(std::size_t index) {
+      return index < m_columnStores.size() ? m_columnStores[index] : nullptr;
+    }
+
+    bool createColumnStoreAt(std::size_t index, ColumnStoreBase *store);
+    void attachColumnComponentAt(Entity e, std::size_t index);
+    bool removeColumnComponentAt(Entity e, std::size_t index);
+
+    bool addComponentAt(Entity e, std::size_t index, Component *c, CommandBuffer::Deleter deleter = nullptr);
+    Component *extractComponentAt(Entity e, std::size_t index);
+    bool destroyComponentAt(Entity e, std::size_t index);
+    void markChangedAt(Entity e, std::size_t index);
+    Component *writeComponentAt(Entity e, std::size_t index);
+
+    void registerObserverAt(std::size_t index, ComponentEvent event, ComponentObserver observer);
+    void notify(std::size_t index, ComponentEvent event, Entity e);
+    void dispatchComponentEvents();
+
+    struct EventData {
+      explicit EventData(EventType t)
+      : type(t) {
+      }
+
+      EventType type;
+      std::vector<EventHandler> handlers;
+      std::unique_ptr<HandlerList> list;
+    };
+
+    EventData *getEventData(std::size_t index);
+
+    EventData *findEventData(std::size_t index) {
+      return index < m_events.size() ? m_events[index].get() : nullptr;
+    }
+
+    struct QueueTable {
+      explicit QueueTable(std::size_t n);
+
+      std::unique_ptr<std::atomic<EventQueue *>[]> queues;
+      const std::size_t size;
+    };
+
+    EventQueue *findEventQueue(std::size_t index) const;
+    void addEventQueue(std::size_t index, EventQueue *queue);
+
+    template<typename E>
+    TypedHandlerList<E> *getHandlerList() {
+      EventData *data = getEventData(getEventIndex<E>());
+
+      if (data == nullptr) {
+        return nullptr;
+      }
+
+      if (!data->list) {
+        data->list.reset(new TypedHandlerList<E>);
+      }
+
+      return static_cast<TypedHandlerList<E> *>(data->list.get());
+    }
+
+    void registerHandlerAt(std::size_t index, EventHandler handler);
+    void dispatchEvent(Entity origin, EventType type, Event *event, std::vector<EventHandler>& handlers);
+    void flushHandlers();
+    void dispatchQueuedEvents();
+
+    Archetype *getArchetype(const ComponentSignature& signature);
+    void moveToArchetype(Entity e, EntityData& data);
+    void removeFromArchetype(EntityData& data);
+
+    EntityData *getEntityData(Entity e) {
+      return isAlive(e) ? &m_entities[getEntityIndex(e)] : nullptr;
+    }
+
+    std::vector<EntityData> m_entities;
+    std::vector<uint32_t> m_freeIndices;
+    std::atomic<uint32_t> m_nextIndex;
+    std::atomic<uint64_t> m_tick;
+
+    CommandBuffer m_commands;
+    std::vector<SystemData> m_systems;
+    std::unordered_map<ComponentSignature, std::vector<std::size_t>> m_subscriptions;
+    unsigned m_systemsVersion;
+    bool m_scheduleNeeded;
+    bool m_fusionEnabled;
+    std::unique_ptr<ThreadPool> m_threadPool;
+    bool m_concurrentUpdate;
+    std::vector<Store *> m_stores;
+    std::vector<ColumnStoreBase *> m_columnStores;
+    ComponentSignature m_columnSignature;
+
+    bool m_archetypesEnabled;
+    std::vector<std::unique_ptr<Archetype>> m_archetypes;
+    std::unordered_map<ComponentSignature, Archetype *> m_archetypesBySignature;
+
+    // indexed by the index of the event type in the event registry
+    std::vector<std::unique_ptr<EventData>> m_events;
+    unsigned m_dispatchDepth;
+    bool m_handlersDirty;
+    std::vector<std::pair<std::size_t, EventHandler>> m_pendingHandlers;
+    std::vector<std::unique_ptr<EventQueue>> m_queues;
+    std::mutex m_queuesMutex;
+    std::atomic<QueueTable *> m_queueTable; // read without the lock
+    std::vector<std::unique_ptr<QueueTable>> m_queueTables;
+    std::vector<std::pair<std::size_t, EventQueue *>> m_dispatched;
 
-    std::map<Entity, std::set<ComponentType>> m_entities;
-    std::vector<std::shared_ptr<System>> m_systems;
-    std::map<ComponentType, Store *> m_stores;
-    std::map<EventType, std::vector<EventHandler>> m_handlers;
+    // indexed by the index of the component type in the component registry
+    std::vector<ObserverData> m_observers;
+    std::mutex m_observersMutex;
+    bool m_observersDispatching;
+    std::vector<PendingObserver> m_pendingObservers;
 
   };
 
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_MEMORY_H
+#define ES_MEMORY_H
+
+#include <cstddef>
+
+namespace es {
+
+  /**
+   * @brief The size of a cache line, in bytes.
+   */
+  static const std::size_t CACHE_LINE_SIZE = 64;
+
+  /**
+   * @brief Allocate a block of memory aligned on a cache line.
+   *
+   * @param size the size of the block, in bytes
+   * @returns the block, to be released with deallocateAligned
+   */
+  void *allocateAligned(std::size_t size);
+
+  /**
+   * @brief Release a block allocated with allocateAligned.
+   *
+   * @param ptr the block (may be nullptr)
+   */
+  void deallocateAligned(void *ptr);
+
+}
+
+#endif // ES_MEMORY_H
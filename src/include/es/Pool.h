@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_POOL_H
+#define ES_POOL_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <es/Component.h>
+#include <es/Memory.h>
+
+namespace es {
+
+  /**
+   * @brief A pool of components.
+   *
+   * A pool owns the memory of its components. It is the type-erased base of
+   * ComponentPool, so that a Store can destroy the components it owns without
+   * knowing their type.
+   */
+  class Pool {
+  public:
+    virtual ~Pool();
+
+    /**
+     * @brief Destroy a component that was created by this pool.
+     *
+     * @param c the component
+     */
+    virtual void destroy(Component *c) = 0;
+  };
+
+  /**
+   * @brief A pool of components of a given type.
+   *
+   * The components are stored by value in chunks of contiguous memory that
+   * are aligned on a cache line. A chunk is never reallocated so the address
+   * of a component is stable during its whole life, even when the pool grows.
+   * The slots of destroyed components are reused.
+   */
+  template<typename C>
+  class ComponentPool : public Pool {
+    static_assert(std::is_base_of<Component, C>::value, "ComponentPool requires a child of Component");
+    static_assert(std::alignment_of<C>::value <= CACHE_LINE_SIZE, "C must not be over-aligned");
+  public:
+    /**
+     * @brief Create a pool.
+     *
+     * @param chunkSize the number of components in a chunk
+     */
+    explicit ComponentPool(std::size_t chunkSize = 256)
+    : m_chunkSize(chunkSize), m_used(chunkSize) {
+      assert(chunkSize > 0);
+    }
+
+    ComponentPool(const ComponentPool&) = delete;
+    ComponentPool& operator=(const ComponentPool&) = delete;
+
+    /**
+     * @brief Destroy the pool and all the components that are still alive.
+     */
+    virtual ~ComponentPool() {
+      std::sort(m_free.begin(), m_free.end());
+
+      for (std::size_t i = 0; i < m_chunks.size(); ++i) {
+        C *chunk = getChunk(i);
+        std::size_t count = (i + 1 == m_chunks.size()) ? m_used : m_chunkSize;
+
+        for (std::size_t j = 0; j < count; ++j) {
+          if (!std::binary_search(m_free.begin(), m_free.end(), chunk + j)) {
+            chunk[j].~C();
+          }
+        }
+
+        deallocateAligned(chunk);
+      }
+    }
+
+    /**
+     * @brief Create a component in the pool.
+     *
+     * @param args the arguments to pass to the component's constructor
+     * @returns the new component
+     */
+    template<typename ... Args>
+    C *create(Args&&... args) {
+      C *c = allocate();
+      return new (c) C(std::forward<Args>(args)...);
+    }
+
+    virtual void destroy(Component *c) override {
+      assert(c);
+      C *obj = static_cast<C *>(c);
+      obj->~C();
+      m_free.push_back(obj);
+    }
+
+  private:
+    C *getChunk(std::size_t i) const {
+      return m_chunks[i];
+    }
+
+    C *allocate() {
+      if (!m_free.empty()) {
+        C *c = m_free.back();
+        m_free.pop_back();
+        return c;
+      }
+
+      if (m_used == m_chunkSize) {
+        m_chunks.push_back(static_cast<C *>(allocateAligned(m_chunkSize * sizeof(C))));
+        m_used = 0;
+      }
+
+      return getChunk(m_chunks.size() - 1) + m_used++;
+    }
+
+    const std::size_t m_chunkSize;
+    std::size_t m_used;
+    std::vector<C *> m_chunks;
+    std::vector<C *> m_free;
+  };
+
+}
+
+#endif // ES_POOL_H
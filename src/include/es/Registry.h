@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_REGISTRY_H
+#define ES_REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include <es/Type.h>
+
+namespace es {
+
+  /**
+   * @brief An invalid index in a registry.
+   */
+  static const std::size_t INVALID_TYPE_INDEX = static_cast<std::size_t>(-1);
+
+  /**
+   * @brief A registry of types.
+   *
+   * A registry maps types (that are 64-bit hashes) to small dense indices,
+   * in the order of registration. The indices can then be used to index
+   * flat tables or bitsets.
+   *
+   * A type can be registered with a name. If the same type is registered
+   * twice with different names, it means that two different names have the
+   * same hash: this collision is detected and the registration fails.
+   *
+   * The registries are global and their methods can be called from several
+   * threads. The lookup of an index (@a getIndex) does not take a lock: the
+   * indices are kept in an open addressing table whose slots are atomic and
+   * that is replaced by a bigger copy when it is half full (the previous
+   * tables are kept until the registry is destroyed).
+   */
+  class Registry {
+  public:
+    /**
+     * @brief Create a registry.
+     *
+     * @param capacity the maximum number of types in the registry
+     */
+    explicit Registry(std::size_t capacity);
+
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+
+    /**
+     * @brief Register a type.
+     *
+     * If the type is already registered, its index is returned.
+     *
+     * @param type the type
+     * @param name the name of the type or null if it is unknown
+     * @returns the index of the type or INVALID_TYPE_INDEX if there is a
+     *   collision or if the registry is full
+     */
+    std::size_t registerType(Type type, const char *name = nullptr);
+
+    /**
+     * @brief Get the index of a type.
+     *
+     * @param type the type
+     * @returns the index of the type or INVALID_TYPE_INDEX if the type is
+     *   not registered
+     */
+    std::size_t getIndex(Type type) const;
+
+    /**
+     * @brief Get the type at an index.
+     *
+     * @param index the index of the type
+     * @returns the type or INVALID_TYPE if the index is not valid
+     */
+    Type getType(std::size_t index) const;
+
+    /**
+     * @brief Get the number of registered types.
+     *
+     * @returns the number of registered types
+     */
+    std::size_t getSize() const;
+
+    /**
+     * @brief Get the maximum number of types.
+     *
+     * @returns the capacity of the registry
+     */
+    std::size_t getCapacity() const {
+      return m_capacity;
+    }
+
+    /**
+     * @brief Get the registry of component types.
+     *
+     * Its capacity is MAX_COMPONENT_TYPES.
+     *
+     * @returns the registry of component types
+     */
+    static Registry& getComponentRegistry();
+
+    /**
+     * @brief Get the registry of event types.
+     *
+     * Its capacity is not limited.
+     *
+     * @returns the registry of event types
+     */
+    static Registry& getEventRegistry();
+
+    /**
+     * @brief Get the index of a component type in the registry of component types.
+     *
+     * The type is registered with its name the first time and the index is
+     * then cached for the type.
+     *
+     * @returns the index of the component type or INVALID_TYPE_INDEX
+     */
+    template<typename C>
+    static std::size_t getComponentIndex() {
+      static const std::size_t index = getComponentRegistry().registerType(C::type, typeid(C).name());
+      return index;
+    }
+
+    /**
+     * @brief Get the index of an event type in the registry of event types.
+     *
+     * The type is registered with its name the first time and the index is
+     * then cached for the type.
+     *
+     * @returns the index of the event type or INVALID_TYPE_INDEX
+     */
+    template<typename E>
+    static std::size_t getEventIndex() {
+      static const std::size_t index = getEventRegistry().registerType(E::type, typeid(E).name());
+      return index;
+    }
+
+  private:
+    struct Slot {
+      std::atomic<Type> type;
+      std::atomic<std::size_t> index;
+    };
+
+    struct Table {
+      explicit Table(std::size_t size);
+
+      std::size_t find(Type type) const;
+      void insert(Type type, std::size_t index);
+
+      std::unique_ptr<Slot[]> slots;
+      const std::size_t mask;
+    };
+
+    const std::size_t m_capacity;
+
+    std::atomic<Table *> m_table;
+    std::vector<std::unique_ptr<Table>> m_tables;
+
+    mutable std::mutex m_mutex;
+    std::vector<Type> m_types;
+    std::vector<std::string> m_names;
+  };
+
+}
+
+#endif // ES_REGISTRY_H
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_SPATIAL_SYSTEM_H
+#define ES_SPATIAL_SYSTEM_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+#include <es/Bounds.h>
+#include <es/Component.h>
+#include <es/System.h>
+#include <es/Entity.h>
+
+namespace es {
+  class ChangeList;
+  class Store;
+
+  /**
+   * @brief A spatial system.
+   *
+   * A spatial system keeps its entities in a dynamic bounding volume
+   * hierarchy, built from the bounds given by a component (see
+   * @a bindBounds), so that the entities in a region or near a point can be
+   * found without checking every entity.
+   *
+   * The tree stores enlarged bounds (by the margin of the system) so that
+   * an entity that moves a little stays in its leaf. Before each update, the
+   * entities whose bounds component has been modified are refitted, and
+   * only the entities that have left their enlarged bounds are reinserted.
+   * The tree is kept balanced with rotations.
+   */
+  class SpatialSystem : public System {
+  public:
+    /**
+     * @brief Create a spatial system.
+     *
+     * @param priority the priority of the system (small priority will
+     * be executed first)
+     * @param needed the set of needed component types that an entity must
+     * have to be handled properly by this system
+     * @param manager the manager (that is saved in the system so that the
+     * system can easily access the manager)
+     * @param margin the margin added on each side of the bounds of an entity
+     * in the tree
+     */
+    SpatialSystem(int priority, std::set<ComponentType> needed, Manager *manager, float margin)
+      : System(priority, needed, manager), m_boundsType(INVALID_COMPONENT), m_margin(margin), m_changes(nullptr), m_root(INVALID_NODE)
+    {
+      assert(margin >= 0.0f);
+    }
+
+    /**
+     * @brief Add an entity in the system.
+     *
+     * If a bounds component is bound, the entity is inserted in the tree.
+     * Otherwise, nothing is done.
+     *
+     * @param e the entity
+     * @returns true if the entity was added
+     */
+    virtual bool addEntity(Entity e) override;
+
+    /**
+     * @brief Remove an entity from the system.
+     *
+     * @param e the entity
+     * @returns true if the entity was removed
+     */
+    virtual bool removeEntity(Entity e) override;
+
+    /**
+     * @brief Update the entities of the system.
+     *
+     * The tree is refitted first (see @a refit). The entities that are added
+     * or removed during the update are handled in the next update.
+     *
+     * @param delta the time (in second) since the last update
+     */
+    virtual void update(float delta) override;
+
+    /**
+     * @brief Update an entity in the current time step.
+     *
+     * This function is called by update. By default, do nothing.
+     *
+     * @param delta the time (in second) since the last update
+     * @param e the entity
+     */
+    virtual void updateEntity(float delta, Entity e);
+
+    /**
+     * @brief Bind a bounds component to the system.
+     *
+     * @param ct the bounds component type
+     * @param bounds the function that gives the bounds from the component
+     */
+    void bindBounds(ComponentType ct, BoundsFunction bounds);
+
+    /**
+     * @brief Bind a bounds component to the system.
+     *
+     * The function is called as `fn(const C&, Bounds&)`.
+     *
+     * @param fn the function that gives the bounds from the component
+     */
+    template<typename C, typename Fn>
+    void bindBounds(Fn fn) {
+      static_assert(std::is_base_of<Component, C>::value, "C must be a Component");
+      static_assert(C::type != INVALID_COMPONENT, "C must define its type");
+      bindBounds(C::type, [fn](const Component *c, Bounds& bounds) {
+        fn(*static_cast<const C *>(c), bounds);
+      });
+    }
+
+    /**
+     * @brief Update the tree with the new bounds of the entities.
+     *
+     * Only the entities whose bounds component has been modified since the
+     * last refit are checked (see Store::createChangeList). This function is
+     * called automatically by @a update.
+     */
+    void refit();
+
+    /**
+     * @brief Get the bounds of an entity, as of the last refit.
+     *
+     * @param e the entity
+     * @param bounds the bounds of the entity (output)
+     * @returns true if the entity is in the system
+     */
+    bool getBounds(Entity e, Bounds& bounds) const;
+
+    /**
+     * @brief Get the number of entities in the system.
+     *
+     * @returns the number of entities
+     */
+    std::size_t getEntityCount() const {
+      return m_members.size();
+    }
+
+    /**
+     * @brief Get the height of the tree.
+     *
+     * @returns the height of the tree, 0 if the tree is empty
+     */
+    int getHeight() const {
+      return m_root == INVALID_NODE ? 0 : m_nodes[m_root].height + 1;
+    }
+
+    /**
+     * @brief Find the entities whose bounds overlap a box.
+     *
+     * The entities are appended to the result, in no particular order.
+     *
+     * @param bounds the box
+     * @param result the entities (output)
+     */
+    void queryBounds(const Bounds& bounds, std::vector<Entity>& result) const;
+
+    /**
+     * @brief Find the entities whose bounds are in a disc.
+     *
+     * An entity is in the disc if the distance between the center and its
+     * bounds is at most the radius. The entities are appended to the result,
+     * in no particular order.
+     *
+     * @param x the x coordinate of the center
+     * @param y the y coordinate of the center
+     * @param radius the radius of the disc
+     * @param result the entities (output)
+     */
+    void queryRadius(float x, float y, float radius, std::vector<Entity>& result) const;
+
+    /**
+     * @brief Find the k nearest entities of a point.
+     *
+     * The distance of an entity is the distance between the point and its
+     * bounds. The entities are appended to the result, from the nearest to
+     * the farthest.
+     *
+     * @param x the x coordinate of the point
+     * @param y the y coordinate of the point
+     * @param k the number of entities
+     * @param result the entities (output)
+     */
+    void queryNearest(float x, float y, std::size_t k, std::vector<Entity>& result) const;
+
+  private:
+    static const std::size_t INVALID_NODE = static_cast<std::size_t>(-1);
+
+    struct Node {
+      Bounds bounds; // enlarged for a leaf
+      Bounds tight; // only for a leaf
+      std::size_t parent;
+      std::size_t left;
+      std::size_t right;
+      int height; // 0 for a leaf
+      Entity entity;
+
+      bool isLeaf() const {
+        return left == INVALID_NODE;
+      }
+    };
+
+    struct Member {
+      Entity entity;
+      std::size_t node;
+    };
+
+    std::size_t findMember(Entity e) const;
+    bool computeBounds(Store *store, Entity e, Bounds& bounds) const;
+    void refitMember(Store *store, const Member& member);
+
+    std::size_t allocateNode();
+    void freeNode(std::size_t node);
+    void insertLeaf(std::size_t leaf);
+    void removeLeaf(std::size_t leaf);
+    void fixUpwards(std::size_t node);
+    std::size_t balance(std::size_t node);
+
+    ComponentType m_boundsType;
+    BoundsFunction m_bounds;
+    float m_margin;
+    ChangeList *m_changes;
+
+    // the entities, with a sparse index by entity index
+    std::vector<Member> m_members;
+    std::vector<std::size_t> m_positions;
+    std::vector<Entity> m_snapshot;
+
+    // the tree
+    std::size_t m_root;
+    std::vector<Node> m_nodes;
+    std::vector<std::size_t> m_freeNodes;
+  };
+
+}
+
+#endif // ES_SPATIAL_SYSTEM_H
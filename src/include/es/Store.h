@@ -16,25 +16,181 @@
 #ifndef ES_STORE_H
 #define ES_STORE_H
 
+#include <atomic>
 #include <cassert>
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <set>
 #include <type_traits>
+#include <vector>
 
 #include <es/Entity.h>
 #include <es/Component.h>
+#include <es/Pool.h>
 
 namespace es {
 
+  /**
+   * @brief A list of the entities whose component has been modified.
+   *
+   * A change list is created by a store (see Store::createChangeList). When
+   * a component of the store is added or marked as modified, the index of
+   * its entity is appended to the list, only once until the list is
+   * cleared. The indices may be appended concurrently, by systems that
+   * modify the components of different entities on several threads.
+   *
+   * The list holds entity indices, not entities: the owner of the list
+   * looks up its own entity for each index, as the index may have been
+   * recycled since the modification.
+   */
+  class ChangeList {
+  public:
+    ChangeList()
+    : m_capacity(0), m_size(0) {
+    }
+
+    ChangeList(const ChangeList&) = delete;
+    ChangeList& operator=(const ChangeList&) = delete;
+
+    /**
+     * @brief Get the number of modified entities.
+     *
+     * @returns the number of entity indices in the list
+     */
+    std::size_t getSize() const {
+      return m_size.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the index of a modified entity.
+     *
+     * @param position the position in the list (less than getSize())
+     * @returns the entity index
+     */
+    uint32_t getIndexAt(std::size_t position) const {
+      assert(position < getSize());
+      return m_indices[position];
+    }
+
+    /**
+     * @brief Remove all the entity indices from the list.
+     *
+     * This must not be called while the components are being modified.
+     */
+    void clear();
+
+  private:
+    friend class Store;
+
+    void reserve(std::size_t capacity);
+
+    void push(uint32_t index) {
+      assert(index < m_capacity);
+
+      // the load avoids a write on the flag when the index is already here
+      if (m_flags[index].load(std::memory_order_relaxed) || m_flags[index].exchange(true, std::memory_order_relaxed)) {
+        return;
+      }
+
+      m_indices[m_size.fetch_add(1, std::memory_order_relaxed)] = index;
+    }
+
+    std::size_t m_capacity;
+    std::unique_ptr<std::atomic<bool>[]> m_flags;
+    std::unique_ptr<uint32_t[]> m_indices;
+    std::atomic<std::size_t> m_size;
+  };
+
   /**
    * @brief A store.
    *
    * A store is tied to a component type. It handles the association between
    * an entity and its component of this type.
    *
+   * The store is a sparse set: a sparse index, indexed by the entity index, gives
+   * the position of the entity in two packed arrays (one for the entities,
+   * one for the components). All the operations are in constant time and the
+   * packed arrays can be iterated contiguously.
+   *
+   * By default, a store does not own its components. But a store can be
+   * given a Pool, in which case the components can be created directly in
+   * the pool and the store owns them.
+   *
+   * The store records, for each entity, the tick of the last modification
+   * of its component. The tick is read from a clock (usually the clock of
+   * the manager) when the component is added, obtained with @a write or
+   * marked with @a mark. The components obtained with @a get or @a read are
+   * not considered as modified. The systems that only need the modified
+   * entities can also ask for a change list (see @a createChangeList).
+   *
    */
   class Store {
   public:
+    /**
+     * @brief Create a store that does not own its components.
+     */
+    Store()
+    : m_pool(nullptr), m_clock(nullptr) {
+    }
+
+    /**
+     * @brief Create a store that owns its components.
+     *
+     * @param pool the pool of components (the store takes the ownership)
+     */
+    explicit Store(Pool *pool)
+    : m_pool(pool), m_clock(nullptr) {
+      assert(pool);
+    }
+
+    Store(const Store&) = delete;
+    Store& operator=(const Store&) = delete;
+
+    /**
+     * @brief Destroy the store.
+     *
+     * If the store owns its components, the components are destroyed with
+     * the pool.
+     */
+    ~Store();
+
+    /**
+     * @brief Tell whether the store owns its components.
+     *
+     * @returns true if the store has a pool
+     */
+    bool ownsComponents() const {
+      return m_pool != nullptr;
+    }
+
+    /**
+     * @brief Get the pool of the store.
+     *
+     * @returns the pool or null if the store does not own its components
+     */
+    Pool *getPool() {
+      return m_pool;
+    }
+
+    /**
+     * @brief Set the clock of the store.
+     *
+     * @param clock the clock that gives the current tick (or null)
+     */
+    void setClock(const std::atomic<uint64_t> *clock) {
+      m_clock = clock;
+    }
+
+    /**
+     * @brief Get the current tick of the clock of the store.
+     *
+     * @returns the current tick or 0 if the store has no clock
+     */
+    uint64_t getCurrentTick() const {
+      return m_clock == nullptr ? 0 : m_clock->load(std::memory_order_relaxed);
+    }
+
     /**
      * @brief Tell whether an entity is present in this store.
      *
@@ -46,12 +202,84 @@ namespace es {
     /**
      * @brief Get the compnent associated to an entity.
      *
+     * This is a pure lookup: the component is not marked as modified (see
+     * @a write and @a mark).
+     *
      * @param e the entity
      * @returns the component or null if the entity has no component of this
      * type
      */
     Component *get(Entity e);
 
+    /**
+     * @brief Get the component associated to an entity for writing.
+     *
+     * The component is marked as modified.
+     *
+     * @param e the entity
+     * @returns the component or null if the entity has no component of this
+     * type
+     */
+    Component *write(Entity e);
+
+    /**
+     * @brief Get the component associated to an entity for reading.
+     *
+     * The component is not marked as modified.
+     *
+     * @param e the entity
+     * @returns the component or null if the entity has no component of this
+     * type
+     */
+    const Component *read(Entity e) const;
+
+    /**
+     * @brief Get the components associated to several entities.
+     *
+     * This is the batch version of @a get and @a write: the sparse array is
+     * walked in a single loop and the current tick is read once.
+     *
+     * @param entities the entities
+     * @param size the number of entities
+     * @param components the components of the entities (null for an entity
+     * that has no component of this type)
+     * @param mark true if the components are marked as modified
+     */
+    void resolve(const Entity *entities, std::size_t size, Component **components, bool mark);
+
+    /**
+     * @brief Mark the component associated to an entity as modified.
+     *
+     * @param e the entity
+     * @returns true if the entity has a component in this store
+     */
+    bool mark(Entity e);
+
+    /**
+     * @brief Create a change list for the components of this store.
+     *
+     * The list is empty when it is created: the entities added or modified
+     * before are not in the list. The list is owned by the store.
+     *
+     * @returns a new change list
+     */
+    ChangeList *createChangeList();
+
+    /**
+     * @brief Destroy a change list of this store.
+     *
+     * @param list the change list (created by @a createChangeList)
+     */
+    void destroyChangeList(ChangeList *list);
+
+    /**
+     * @brief Get the tick of the last modification of a component.
+     *
+     * @param e the entity
+     * @returns the tick or 0 if the entity has no component of this type
+     */
+    uint64_t getChangeTick(Entity e) const;
+
     /**
      * @brief Add a component to an entity
      *
@@ -75,6 +303,17 @@ namespace es {
      */
     bool remove(Entity e);
 
+    /**
+     * @brief Remove a component from an entity and destroy it
+     *
+     * This only works if the store owns its components. Otherwise, nothing
+     * is done.
+     *
+     * @param e the entity
+     * @returns true if the component was actually removed and destroyed
+     */
+    bool destroy(Entity e);
+
     /**
      * @brief Get all the entities that have a component of this type
      *
@@ -82,11 +321,87 @@ namespace es {
      */
     std::set<Entity> getEntities() const;
 
+    /**
+     * @brief Get the number of entities in this store
+     *
+     * @returns the number of entities
+     */
+    std::size_t getSize() const {
+      return m_entities.size();
+    }
+
+    /**
+     * @brief Get the entity at a position in the packed array
+     *
+     * The order of the packed array changes when an entity is removed.
+     *
+     * @param index the position in the packed array (less than getSize())
+     * @returns the entity
+     */
+    Entity getEntityAt(std::size_t index) const {
+      assert(index < m_entities.size());
+      return m_entities[index];
+    }
+
+    /**
+     * @brief Get the component at a position in the packed array
+     *
+     * The component is not marked as modified.
+     *
+     * @param index the position in the packed array (less than getSize())
+     * @returns the component
+     */
+    Component *getComponentAt(std::size_t index) const {
+      assert(index < m_components.size());
+      return m_components[index];
+    }
+
+    /**
+     * @brief Get the tick of the last modification at a position in the packed array
+     *
+     * @param index the position in the packed array (less than getSize())
+     * @returns the tick
+     */
+    uint64_t getChangeTickAt(std::size_t index) const {
+      assert(index < m_ticks.size());
+      return m_ticks[index];
+    }
+
   private:
     template <typename C>
     friend class ComponentStore;
 
-    std::map<Entity, Component *> m_store;
+    std::size_t getSlot(Entity e) const {
+      uint32_t index = getEntityIndex(e);
+
+      if (index >= m_sparse.size()) {
+        return INVALID_SLOT;
+      }
+
+      std::size_t slot = m_sparse[index];
+
+      if (slot >= m_entities.size() || m_entities[slot] != e) {
+        return INVALID_SLOT;
+      }
+
+      return slot;
+    }
+
+    void recordChange(Entity e) {
+      for (ChangeList *list : m_changeLists) {
+        list->push(getEntityIndex(e));
+      }
+    }
+
+    static const std::size_t INVALID_SLOT = static_cast<std::size_t>(-1);
+
+    Pool * const m_pool;
+    const std::atomic<uint64_t> *m_clock;
+    std::vector<std::size_t> m_sparse;
+    std::vector<Entity> m_entities;
+    std::vector<Component *> m_components;
+    std::vector<uint64_t> m_ticks;
+    std::vector<ChangeList *> m_changeLists;
   };
 
   /**
@@ -123,6 +438,38 @@ namespace es {
       return static_cast<C *>(m_store->get(e));
     }
 
+    /**
+     * @brief Get the component associated to an entity for writing.
+     *
+     * @param e the entity
+     * @returns the component or null if the entity has no component of this
+     * type
+     */
+    C *write(Entity e) {
+      return static_cast<C *>(m_store->write(e));
+    }
+
+    /**
+     * @brief Get the component associated to an entity for reading.
+     *
+     * @param e the entity
+     * @returns the component or null if the entity has no component of this
+     * type
+     */
+    const C *read(Entity e) const {
+      return static_cast<const C *>(m_store->read(e));
+    }
+
+    /**
+     * @brief Mark the component associated to an entity as modified.
+     *
+     * @param e the entity
+     * @returns true if the entity has a component in this store
+     */
+    bool mark(Entity e) {
+      return m_store->mark(e);
+    }
+
     /**
      * @brief Add a component to an entity
      *
@@ -150,6 +497,68 @@ namespace es {
       return m_store->remove(e);
     }
 
+    /**
+     * @brief Create a component in the store and add it to an entity
+     *
+     * The store must own its components and its pool must be a pool of C.
+     *
+     * @param e the entity
+     * @param args the arguments to pass to the component's constructor
+     * @returns the component or null if the component was not added
+     */
+    template<typename ... Args>
+    C *emplace(Entity e, Args&&... args) {
+      assert(m_store->ownsComponents());
+      ComponentPool<C> *pool = static_cast<ComponentPool<C> *>(m_store->getPool());
+      C *c = pool->create(std::forward<Args>(args)...);
+
+      if (!m_store->add(e, c)) {
+        pool->destroy(c);
+        return nullptr;
+      }
+
+      return c;
+    }
+
+    /**
+     * @brief Remove a component from an entity and destroy it
+     *
+     * @param e the entity
+     * @returns true if the component was actually removed and destroyed
+     */
+    bool destroy(Entity e) {
+      return m_store->destroy(e);
+    }
+
+    /**
+     * @brief Get the number of entities in this store
+     *
+     * @returns the number of entities
+     */
+    std::size_t getSize() const {
+      return m_store->getSize();
+    }
+
+    /**
+     * @brief Get the entity at a position in the packed array
+     *
+     * @param index the position in the packed array (less than getSize())
+     * @returns the entity
+     */
+    Entity getEntityAt(std::size_t index) const {
+      return m_store->getEntityAt(index);
+    }
+
+    /**
+     * @brief Get the component at a position in the packed array
+     *
+     * @param index the position in the packed array (less than getSize())
+     * @returns the component
+     */
+    C *getComponentAt(std::size_t index) const {
+      return static_cast<C *>(m_store->getComponentAt(index));
+    }
+
   private:
     Store * const m_store;
   };
@@ -16,6 +16,7 @@
 #ifndef ES_SYSTEM_H
 #define ES_SYSTEM_H
 
+#include <cstdint>
 #include <set>
 
 #include <es/Component.h>
@@ -44,7 +45,7 @@ namespace es {
      * system can easily access the manager)
      */
     System(int priority, std::set<ComponentType> needed, Manager *manager)
-    : m_priority(priority), m_needed(needed), m_manager(manager) {
+    : m_priority(priority), m_needed(needed), m_accessDeclared(false), m_lastRunTick(0), m_manager(manager) {
     }
 
     virtual ~System();
@@ -67,6 +68,45 @@ namespace es {
       return m_needed;
     }
 
+    /**
+     * @brief Tell whether the system has declared its access to components.
+     *
+     * @returns true if the system has declared its access
+     */
+    bool hasDeclaredAccess() const {
+      return m_accessDeclared;
+    }
+
+    /**
+     * @brief Get the component types that the system reads.
+     *
+     * @returns the component types that the system reads
+     */
+    std::set<ComponentType> getReadComponents() const {
+      return m_reads;
+    }
+
+    /**
+     * @brief Get the component types that the system writes.
+     *
+     * @returns the component types that the system writes
+     */
+    std::set<ComponentType> getWrittenComponents() const {
+      return m_writes;
+    }
+
+    /**
+     * @brief Get the tick of the manager at the end of the last update.
+     *
+     * The components that have a change tick greater than this tick have
+     * been modified since the last update of the system by the manager.
+     *
+     * @returns the tick or 0 if the system has never been updated
+     */
+    uint64_t getLastRunTick() const {
+      return m_lastRunTick;
+    }
+
     /**
      * @brief Get the manager.
      *
@@ -127,10 +167,38 @@ namespace es {
      */
     virtual void update(float delta);
 
+  protected:
+    /**
+     * @brief Declare the component types that the system accesses.
+     *
+     * A system that declares its access can be run concurrently with the
+     * systems that do not access the same component types in a conflicting
+     * way (see Manager::setThreadCount). A system that does not declare its
+     * access is never run concurrently with another system. This function
+     * must be called before Manager::initSystems, typically in the
+     * constructor of the system.
+     *
+     * @param reads the component types that the system only reads
+     * @param writes the component types that the system writes (and reads)
+     */
+    void declareAccess(std::set<ComponentType> reads, std::set<ComponentType> writes) {
+      m_reads = reads;
+      m_writes = writes;
+      m_accessDeclared = true;
+    }
+
   private:
+    friend class Manager;
+
     const int m_priority;
     const std::set<ComponentType> m_needed;
 
+    bool m_accessDeclared;
+    std::set<ComponentType> m_reads;
+    std::set<ComponentType> m_writes;
+
+    uint64_t m_lastRunTick;
+
     Manager * const m_manager;
 
   };
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_THREAD_POOL_H
+#define ES_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace es {
+
+  /**
+   * @brief A group of tasks.
+   *
+   * A task group counts the tasks that have been submitted to a thread pool
+   * and that are not finished yet, so that a thread can wait for them.
+   */
+  class TaskGroup {
+  public:
+    TaskGroup()
+    : m_pending(0) {
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * @brief Tell whether all the tasks of the group are finished.
+     *
+     * @returns true if there is no pending task
+     */
+    bool isDone() const {
+      return m_pending.load() == 0;
+    }
+
+  private:
+    friend class ThreadPool;
+
+    std::atomic<std::size_t> m_pending;
+  };
+
+  /**
+   * @brief A pool of worker threads.
+   *
+   * Tasks are submitted in a group. A thread that waits for a group executes
+   * the pending tasks in the meantime, so that a task can itself submit tasks
+   * and wait for them.
+   *
+   * Each worker has its own queue of tasks. A task submitted by a worker is
+   * put in its own queue, where it is taken in last-in first-out order. An
+   * idle worker steals tasks from the other queues, in first-in first-out
+   * order.
+   */
+  class ThreadPool {
+  public:
+    /**
+     * @brief A task.
+     */
+    typedef std::function<void()> Task;
+
+    /**
+     * @brief Create a thread pool.
+     *
+     * @param count the number of worker threads
+     */
+    explicit ThreadPool(unsigned count);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Stop the worker threads.
+     *
+     * All the task groups must have been waited for.
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Get the number of worker threads.
+     *
+     * @returns the number of worker threads
+     */
+    unsigned getThreadCount() const {
+      return static_cast<unsigned>(m_threads.size());
+    }
+
+    /**
+     * @brief Get the index of the calling thread.
+     *
+     * The threads that are not workers share the last index.
+     *
+     * @returns the index of the worker thread or getThreadCount() if the
+     * calling thread is not a worker thread
+     */
+    std::size_t getThreadIndex() const {
+      return getCurrentQueue();
+    }
+
+    /**
+     * @brief Submit a task.
+     *
+     * @param group the group of the task
+     * @param task the task
+     */
+    void submit(TaskGroup& group, Task task);
+
+    /**
+     * @brief Wait for all the tasks of a group.
+     *
+     * The calling thread executes pending tasks while it waits.
+     *
+     * @param group the group
+     */
+    void wait(TaskGroup& group);
+
+    /**
+     * @brief Execute a function on a range in parallel.
+     *
+     * The range is split recursively in chunks of at most @a grain elements
+     * and the function is called on each chunk with the bounds of the chunk.
+     * The function returns when all the chunks have been processed.
+     *
+     * @param begin the beginning of the range
+     * @param end the end of the range (excluded)
+     * @param grain the maximum number of elements in a chunk
+     * @param fn the function, called with the bounds of a chunk
+     */
+    void parallelFor(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& fn);
+
+  private:
+    struct Job {
+      Task task;
+      TaskGroup *group;
+    };
+
+    struct Queue {
+      std::mutex mutex;
+      std::deque<Job> jobs;
+    };
+
+    void work(std::size_t index);
+    std::size_t getCurrentQueue() const;
+    bool take(std::size_t index, Job& job);
+    void execute(Job& job);
+    void split(TaskGroup& group, std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& fn);
+
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::atomic<std::size_t> m_queued;
+    std::atomic<std::size_t> m_next;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop;
+  };
+
+}
+
+#endif // ES_THREAD_POOL_H
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#ifndef ES_VIEW_H
+#define ES_VIEW_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include <es/Archetype.h>
+#include <es/Component.h>
+#include <es/Entity.h>
+#include <es/Store.h>
+
+namespace es {
+  class Manager;
+
+  /**
+   * @brief A reference to the components of a given type.
+   *
+   * The components are looked up without being marked as modified. If the
+   * type is not const, they are marked afterwards through the manager (see
+   * Manager::markChanged), once the entity is known to have all the
+   * components of the view.
+   *
+   * This is a building block of View, it should not be used directly.
+   */
+  template<typename C>
+  class ComponentRef {
+    static_assert(std::is_base_of<Component, C>::value, "ComponentRef requires a child of Component");
+  public:
+    /**
+     * @brief The store of the component type.
+     */
+    typedef Store *StoreType;
+
+    explicit ComponentRef(Store *store)
+    : m_store(store), m_current(nullptr), m_column(nullptr) {
+    }
+
+    Store *getStore() const {
+      return m_store;
+    }
+
+    bool fetch(Entity e) {
+      m_current = static_cast<C *>(m_store->get(e));
+      return m_current != nullptr;
+    }
+
+    C& getCurrent() const {
+      return *m_current;
+    }
+
+    void bind(const Archetype *archetype) {
+      std::size_t column = archetype->template getColumnIndex<typename std::remove_const<C>::type>();
+      assert(column != INVALID_TYPE_INDEX);
+      m_column = archetype->getColumn(column);
+    }
+
+    C& getAt(std::size_t row) const {
+      return *static_cast<C *>(m_column[row]);
+    }
+
+    // the manager is a template parameter as Manager is not complete here
+    template<typename M>
+    void mark(M *manager, Entity e) const {
+      mark(manager, e, std::is_const<C>());
+    }
+
+  private:
+    template<typename M>
+    void mark(M *manager, Entity e, std::true_type) const {
+    }
+
+    template<typename M>
+    void mark(M *manager, Entity e, std::false_type) const {
+      manager->template markChanged<C>(e);
+    }
+
+    Store *m_store;
+    C *m_current;
+    Component * const *m_column;
+  };
+
+  /**
+   * @brief A view on the entities that have some components.
+   *
+   * A view resolves the stores of the component types once and then calls a
+   * function with the entity and a reference to each of its components,
+   * without any lookup of the component types and without virtual dispatch.
+   *
+   * The function passed to the @a each methods must have the signature:
+   * `void(Entity, C&...)`. It must not add or remove components, except that
+   * it can remove components of the current entity when iterating over the
+   * stores. A component type can be const (e.g. `View<const Position>`), in
+   * which case its components are not marked as modified. The components of
+   * the other types are marked as modified, and the observers of their
+   * changes are notified, before the function is called.
+   */
+  template<typename ... C>
+  class View : private ComponentRef<C>... {
+    static_assert(sizeof...(C) > 0, "View requires at least one component type");
+  public:
+    /**
+     * @brief Create a view.
+     *
+     * @param manager the manager that owns the stores
+     * @param stores the stores of the component types (in the same order)
+     */
+    explicit View(Manager *manager, typename ComponentRef<C>::StoreType... stores)
+    : ComponentRef<C>(stores)..., m_manager(manager) {
+    }
+
+    /**
+     * @brief Tell whether the view is valid, i.e. all the stores exist.
+     *
+     * @returns true if the view is valid
+     */
+    bool isValid() const {
+      Store *stores[] = { ComponentRef<C>::getStore()... };
+
+      for (Store *store : stores) {
+        if (store == nullptr) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    /**
+     * @brief Call a function on all the entities that have the components.
+     *
+     * The smallest store is iterated and the other components are resolved
+     * directly in their store.
+     *
+     * @param fn the function
+     */
+    template<typename Fn>
+    void each(Fn fn) {
+      if (!isValid()) {
+        return;
+      }
+
+      Store *stores[] = { ComponentRef<C>::getStore()... };
+      Store *smallest = stores[0];
+
+      for (Store *store : stores) {
+        if (store->getSize() < smallest->getSize()) {
+          smallest = store;
+        }
+      }
+
+      // backwards, so that the current entity can be removed from the store
+      for (std::size_t i = smallest->getSize(); i > 0; --i) {
+        Entity e = smallest->getEntityAt(i - 1);
+
+        if (fetch(e)) {
+          touch(e);
+          fn(e, ComponentRef<C>::getCurrent()...);
+        }
+      }
+    }
+
+    /**
+     * @brief Call a function on some entities that have the components.
+     *
+     * The entities that do not have all the components are skipped.
+     *
+     * @param entities the entities (any range of entities)
+     * @param fn the function
+     */
+    template<typename Range, typename Fn>
+    void each(const Range& entities, Fn fn) {
+      if (!isValid()) {
+        return;
+      }
+
+      for (Entity e : entities) {
+        if (fetch(e)) {
+          touch(e);
+          fn(e, ComponentRef<C>::getCurrent()...);
+        }
+      }
+    }
+
+    /**
+     * @brief Call a function on all the entities of some archetypes.
+     *
+     * All the archetypes must contain the components.
+     *
+     * @param archetypes the archetypes
+     * @param fn the function
+     */
+    template<typename Fn>
+    void each(const std::vector<Archetype *>& archetypes, Fn fn) {
+      for (const Archetype *archetype : archetypes) {
+        bind(archetype);
+        const Entity *entities = archetype->getEntities();
+
+        for (std::size_t row = archetype->getSize(); row > 0; --row) {
+          Entity e = entities[row - 1];
+          touch(e);
+          fn(e, ComponentRef<C>::getAt(row - 1)...);
+        }
+      }
+    }
+
+  private:
+    bool fetch(Entity e) {
+      bool found[] = { ComponentRef<C>::fetch(e)... };
+
+      for (bool f : found) {
+        if (!f) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    void bind(const Archetype *archetype) {
+      int dummy[] = { (ComponentRef<C>::bind(archetype), 0)... };
+      (void) dummy;
+    }
+
+    void touch(Entity e) {
+      int dummy[] = { (ComponentRef<C>::mark(m_manager, e), 0)... };
+      (void) dummy;
+    }
+
+    Manager *m_manager;
+  };
+
+}
+
+#endif // ES_VIEW_H
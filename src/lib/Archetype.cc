@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/Archetype.h>
+
+namespace es {
+
+  Archetype::Archetype(const ComponentSignature& signature)
+  : m_signature(signature) {
+    std::size_t columns = 0;
+
+    for (std::size_t index = 0; index < MAX_COMPONENT_TYPES; ++index) {
+      m_columnOf[index] = signature.test(index) ? columns++ : INVALID_TYPE_INDEX;
+    }
+
+    m_columns.resize(columns);
+  }
+
+  std::size_t Archetype::getColumnIndex(ComponentType ct) const {
+    std::size_t index = Registry::getComponentRegistry().getIndex(ct);
+
+    if (index == INVALID_TYPE_INDEX) {
+      return INVALID_TYPE_INDEX;
+    }
+
+    return m_columnOf[index];
+  }
+
+  std::size_t Archetype::addRow(Entity e) {
+    std::size_t row = m_entities.size();
+    m_entities.push_back(e);
+
+    for (auto& column : m_columns) {
+      column.push_back(nullptr);
+    }
+
+    return row;
+  }
+
+  Entity Archetype::removeRow(std::size_t row) {
+    assert(row < m_entities.size());
+    std::size_t last = m_entities.size() - 1;
+    Entity moved = INVALID_ENTITY;
+
+    if (row != last) {
+      moved = m_entities[last];
+      m_entities[row] = moved;
+
+      for (auto& column : m_columns) {
+        column[row] = column[last];
+      }
+    }
+
+    m_entities.pop_back();
+
+    for (auto& column : m_columns) {
+      column.pop_back();
+    }
+
+    return moved;
+  }
+
+}
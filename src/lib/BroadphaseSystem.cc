@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/BroadphaseSystem.h>
+
+#include <cassert>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <es/Manager.h>
+
+namespace es {
+
+  bool BroadphaseSystem::addEntity(Entity e) {
+    if (m_boundsType == INVALID_COMPONENT || findSlot(e) != INVALID_SLOT) {
+      return false;
+    }
+
+    Store *store = getManager()->getStore(m_boundsType);
+    const Component *c = store != nullptr ? store->read(e) : nullptr;
+
+    if (c == nullptr) {
+      return false;
+    }
+
+    Bounds bounds;
+    m_bounds(c, bounds);
+
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_slots.size()) {
+      m_slots.resize(index + 1, INVALID_SLOT);
+    }
+
+    // the new entity is put in place by the next sort
+    std::size_t slot = m_entities.size();
+    m_slots[index] = slot;
+    m_entities.push_back(e);
+    m_xmin.push_back(0.0f);
+    m_xmax.push_back(0.0f);
+    m_ymin.push_back(0.0f);
+    m_ymax.push_back(0.0f);
+    setBounds(slot, bounds);
+    return true;
+  }
+
+  bool BroadphaseSystem::removeEntity(Entity e) {
+    std::size_t slot = findSlot(e);
+
+    if (slot == INVALID_SLOT) {
+      return false;
+    }
+
+    // the slot is reclaimed by the next update, so that the order is kept
+    m_slots[getEntityIndex(e)] = INVALID_SLOT;
+    m_entities[slot] = INVALID_ENTITY;
+    m_removed++;
+    return true;
+  }
+
+  void BroadphaseSystem::update(float delta) {
+    compact();
+    refresh();
+    sort();
+    sweep();
+
+    for (const ContactPair& pair : m_pairs) {
+      updatePair(delta, pair.first, pair.second);
+    }
+  }
+
+  void BroadphaseSystem::updatePair(float delta, Entity first, Entity second) {
+    // nothing by default
+  }
+
+  void BroadphaseSystem::bindBounds(ComponentType ct, BoundsFunction bounds) {
+    assert(ct != INVALID_COMPONENT);
+    assert(bounds);
+    m_bounds = std::move(bounds);
+
+    if (m_changes != nullptr) {
+      getManager()->getStore(m_boundsType)->destroyChangeList(m_changes);
+      m_changes = nullptr;
+    }
+
+    m_boundsType = ct;
+  }
+
+  std::size_t BroadphaseSystem::findSlot(Entity e) const {
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_slots.size()) {
+      return INVALID_SLOT;
+    }
+
+    std::size_t slot = m_slots[index];
+
+    if (slot == INVALID_SLOT || m_entities[slot] != e) {
+      return INVALID_SLOT;
+    }
+
+    return slot;
+  }
+
+  void BroadphaseSystem::setBounds(std::size_t slot, const Bounds& bounds) {
+    m_xmin[slot] = bounds.xmin;
+    m_xmax[slot] = bounds.xmax;
+    m_ymin[slot] = bounds.ymin;
+    m_ymax[slot] = bounds.ymax;
+  }
+
+  void BroadphaseSystem::refresh() {
+    if (m_boundsType == INVALID_COMPONENT) {
+      return;
+    }
+
+    Store *store = getManager()->getStore(m_boundsType);
+
+    if (store == nullptr) {
+      return;
+    }
+
+    if (m_changes == nullptr) {
+      // the previous modifications are unknown, read all the bounds once
+      m_changes = store->createChangeList();
+
+      for (std::size_t slot = 0; slot < m_entities.size(); ++slot) {
+        refreshSlot(store, slot);
+      }
+
+      return;
+    }
+
+    for (std::size_t i = 0; i < m_changes->getSize(); ++i) {
+      uint32_t index = m_changes->getIndexAt(i);
+
+      if (index < m_slots.size() && m_slots[index] != INVALID_SLOT) {
+        refreshSlot(store, m_slots[index]);
+      }
+    }
+
+    m_changes->clear();
+  }
+
+  void BroadphaseSystem::refreshSlot(Store *store, std::size_t slot) {
+    const Component *c = store->read(m_entities[slot]);
+
+    if (c != nullptr) {
+      Bounds bounds;
+      m_bounds(c, bounds);
+      setBounds(slot, bounds);
+    }
+  }
+
+  void BroadphaseSystem::compact() {
+    if (m_removed == 0) {
+      return;
+    }
+
+    std::size_t count = 0;
+
+    for (std::size_t slot = 0; slot < m_entities.size(); ++slot) {
+      Entity e = m_entities[slot];
+
+      if (e == INVALID_ENTITY) {
+        continue;
+      }
+
+      if (count != slot) {
+        m_entities[count] = e;
+        m_xmin[count] = m_xmin[slot];
+        m_xmax[count] = m_xmax[slot];
+        m_ymin[count] = m_ymin[slot];
+        m_ymax[count] = m_ymax[slot];
+        m_slots[getEntityIndex(e)] = count;
+      }
+
+      count++;
+    }
+
+    m_entities.resize(count);
+    m_xmin.resize(count);
+    m_xmax.resize(count);
+    m_ymin.resize(count);
+    m_ymax.resize(count);
+    m_removed = 0;
+  }
+
+  void BroadphaseSystem::sort() {
+    /*
+     * insertion sort by xmin, almost linear as the order does not change
+     * much between two updates
+     */
+    for (std::size_t i = 1; i < m_entities.size(); ++i) {
+      float xmin = m_xmin[i];
+
+      if (!(xmin < m_xmin[i - 1])) {
+        continue;
+      }
+
+      float xmax = m_xmax[i];
+      float ymin = m_ymin[i];
+      float ymax = m_ymax[i];
+      Entity e = m_entities[i];
+
+      std::size_t j = i;
+
+      do {
+        m_xmin[j] = m_xmin[j - 1];
+        m_xmax[j] = m_xmax[j - 1];
+        m_ymin[j] = m_ymin[j - 1];
+        m_ymax[j] = m_ymax[j - 1];
+        m_entities[j] = m_entities[j - 1];
+        m_slots[getEntityIndex(m_entities[j])] = j;
+        --j;
+      } while (j > 0 && xmin < m_xmin[j - 1]);
+
+      m_xmin[j] = xmin;
+      m_xmax[j] = xmax;
+      m_ymin[j] = ymin;
+      m_ymax[j] = ymax;
+      m_entities[j] = e;
+      m_slots[getEntityIndex(e)] = j;
+    }
+  }
+
+  void BroadphaseSystem::sweep() {
+    m_pairs.clear();
+
+    std::size_t n = m_entities.size();
+
+    for (std::size_t i = 0; i < n; ++i) {
+      float xmax = m_xmax[i];
+      float ymin = m_ymin[i];
+      float ymax = m_ymax[i];
+
+      std::size_t j = i + 1;
+
+#ifdef __SSE2__
+      __m128 xmax4 = _mm_set1_ps(xmax);
+      __m128 ymin4 = _mm_set1_ps(ymin);
+      __m128 ymax4 = _mm_set1_ps(ymax);
+
+      bool done = false;
+
+      for (; j + 4 <= n; j += 4) {
+        // the entities are sorted by xmin, so the x mask is a prefix
+        int xmask = _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&m_xmin[j]), xmax4));
+
+        if (xmask == 0) {
+          done = true;
+          break;
+        }
+
+        __m128 yoverlap = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&m_ymin[j]), ymax4), _mm_cmpge_ps(_mm_loadu_ps(&m_ymax[j]), ymin4));
+        int mask = xmask & _mm_movemask_ps(yoverlap);
+
+        for (int k = 0; mask != 0; ++k, mask >>= 1) {
+          if ((mask & 1) != 0) {
+            m_pairs.push_back({ m_entities[i], m_entities[j + k] });
+          }
+        }
+
+        if (xmask != 0xF) {
+          done = true;
+          break;
+        }
+      }
+
+      if (done) {
+        continue;
+      }
+#endif
+
+      for (; j < n && m_xmin[j] <= xmax; ++j) {
+        if (m_ymin[j] <= ymax && ymin <= m_ymax[j]) {
+          m_pairs.push_back({ m_entities[i], m_entities[j] });
+        }
+      }
+    }
+  }
+
+  const std::size_t BroadphaseSystem::INVALID_SLOT;
+
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/ColumnStore.h>
+
+#include <cstring>
+
+namespace es {
+
+  ColumnStoreBase::ColumnStoreBase(std::vector<std::size_t> sizes)
+  : m_capacity(0) {
+    for (std::size_t size : sizes) {
+      m_columns.push_back({ size, nullptr });
+    }
+  }
+
+  ColumnStoreBase::~ColumnStoreBase() {
+    for (Column& column : m_columns) {
+      deallocateAligned(column.data);
+    }
+  }
+
+  std::size_t ColumnStoreBase::find(Entity e) const {
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_rows.size()) {
+      return INVALID_ROW;
+    }
+
+    std::size_t row = m_rows[index];
+
+    if (row == INVALID_ROW || m_entities[row] != e) {
+      return INVALID_ROW;
+    }
+
+    return row;
+  }
+
+  bool ColumnStoreBase::remove(Entity e) {
+    std::size_t row = find(e);
+
+    if (row == INVALID_ROW) {
+      return false;
+    }
+
+    std::size_t last = m_entities.size() - 1;
+    m_rows[getEntityIndex(e)] = INVALID_ROW;
+
+    if (row != last) {
+      for (Column& column : m_columns) {
+        std::memcpy(column.data + row * column.size, column.data + last * column.size, column.size);
+      }
+
+      m_entities[row] = m_entities[last];
+      m_rows[getEntityIndex(m_entities[row])] = row;
+    }
+
+    m_entities.pop_back();
+    return true;
+  }
+
+  std::size_t ColumnStoreBase::insert(Entity e, const void * const *values) {
+    if (e == INVALID_ENTITY || find(e) != INVALID_ROW) {
+      return INVALID_ROW;
+    }
+
+    if (m_entities.size() == m_capacity) {
+      grow();
+    }
+
+    std::size_t row = m_entities.size();
+
+    for (std::size_t i = 0; i < m_columns.size(); ++i) {
+      Column& column = m_columns[i];
+      std::memcpy(column.data + row * column.size, values[i], column.size);
+    }
+
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_rows.size()) {
+      m_rows.resize(index + 1, INVALID_ROW);
+    }
+
+    m_rows[index] = row;
+    m_entities.push_back(e);
+    return row;
+  }
+
+  void ColumnStoreBase::grow() {
+    std::size_t capacity = m_capacity == 0 ? PADDING : 2 * m_capacity;
+
+    for (Column& column : m_columns) {
+      unsigned char *data = static_cast<unsigned char *>(allocateAligned(capacity * column.size));
+
+      if (column.data != nullptr) {
+        std::memcpy(data, column.data, m_entities.size() * column.size);
+      }
+
+      deallocateAligned(column.data);
+      column.data = data;
+    }
+
+    m_capacity = capacity;
+  }
+
+  const std::size_t ColumnStoreBase::ALIGNMENT;
+  const std::size_t ColumnStoreBase::PADDING;
+  const std::size_t ColumnStoreBase::INVALID_ROW;
+
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/CommandBuffer.h>
+
+#include <algorithm>
+
+#include <es/Manager.h>
+
+namespace es {
+
+  Entity CommandBuffer::createEntity() {
+    Entity e = m_manager->reserveEntity();
+    record(Action::CREATE, e, INVALID_COMPONENT, nullptr, nullptr);
+    return e;
+  }
+
+  void CommandBuffer::destroyEntity(Entity e) {
+    record(Action::DESTROY, e, INVALID_COMPONENT, nullptr, nullptr);
+  }
+
+  void CommandBuffer::addComponent(Entity e, ComponentType ct, Component *c, Deleter deleter) {
+    record(Action::ADD, e, ct, c, deleter);
+  }
+
+  bool CommandBuffer::removeComponent(Entity e, ComponentType ct) {
+    Store *store = m_manager->getStore(ct);
+
+    if (store == nullptr || !store->ownsComponents()) {
+      return false;
+    }
+
+    record(Action::REMOVE, e, ct, nullptr, nullptr);
+    return true;
+  }
+
+  void CommandBuffer::subscribeEntity(Entity e) {
+    record(Action::SUBSCRIBE, e, INVALID_COMPONENT, nullptr, nullptr);
+  }
+
+  bool CommandBuffer::isEmpty() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_commands.empty();
+  }
+
+  void CommandBuffer::apply() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::swap(m_commands, m_applied);
+    }
+
+    if (m_applied.empty()) {
+      return;
+    }
+
+    /*
+     * sort by entity, so that the commands of an entity are grouped (and the
+     * sparse arrays are accessed in order), but keep the order of the
+     * commands of each entity
+     */
+    std::stable_sort(m_applied.begin(), m_applied.end(), [](const Command& lhs, const Command& rhs) {
+      return getEntityIndex(lhs.entity) < getEntityIndex(rhs.entity);
+    });
+
+    std::size_t i = 0;
+
+    while (i < m_applied.size()) {
+      Entity e = m_applied[i].entity;
+      bool subscribe = false;
+      bool destroyed = false;
+
+      for (; i < m_applied.size() && m_applied[i].entity == e; ++i) {
+        const Command& command = m_applied[i];
+
+        if (destroyed) {
+          if (command.action == Action::ADD) {
+            drop(command);
+          }
+
+          continue;
+        }
+
+        switch (command.action) {
+          case Action::CREATE:
+            m_manager->createReservedEntity(e);
+            break;
+
+          case Action::ADD:
+            if (!m_manager->addComponent(e, command.type, command.component)) {
+              drop(command);
+            }
+            break;
+
+          case Action::REMOVE:
+            m_manager->destroyComponent(e, command.type);
+            break;
+
+          case Action::SUBSCRIBE:
+            subscribe = true;
+            break;
+
+          case Action::DESTROY:
+            m_manager->destroyEntity(e);
+            destroyed = true;
+            break;
+        }
+      }
+
+      if (subscribe && !destroyed) {
+        m_manager->subscribeEntityToSystems(e);
+      }
+    }
+
+    m_applied.clear();
+  }
+
+  void CommandBuffer::drop(const Command& command) {
+    if (command.component == nullptr) {
+      return;
+    }
+
+    // the caller gave the component away when the addition was recorded
+    Store *store = m_manager->getStore(command.type);
+
+    if (store != nullptr && store->ownsComponents()) {
+      store->getPool()->destroy(command.component);
+    } else if (command.deleter != nullptr) {
+      command.deleter(command.component);
+    }
+  }
+
+  void CommandBuffer::record(Action action, Entity e, ComponentType ct, Component *c, Deleter deleter) {
+    Command command;
+    command.action = action;
+    command.entity = e;
+    command.type = ct;
+    command.component = c;
+    command.deleter = deleter;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_commands.push_back(command);
+  }
+
+}
@@ -15,30 +15,313 @@
  */
 #include <es/GlobalSystem.h>
 
+#include <algorithm>
+
 namespace es {
 
+  template<typename Fn>
+  void GlobalSystem::updateTask(Fn fn) {
+    ChunkBuffer& buffer = m_threadBuffers[getManager()->getThreadPool()->getThreadIndex()];
+
+    // a task that waits for the pool may run another task of the system on the same thread
+    if (buffer.busy) {
+      ChunkBuffer local;
+      fn(local);
+      return;
+    }
+
+    buffer.busy = true;
+    fn(buffer);
+    buffer.busy = false;
+  }
+
   bool GlobalSystem::addEntity(Entity e) {
+    if (m_iterating) {
+      m_pending.push_back(std::make_pair(e, true));
+      return m_entities.find(e) == m_entities.end();
+    }
+
     auto ret = m_entities.insert(e);
     return ret.second;
   }
 
   bool GlobalSystem::removeEntity(Entity e) {
+    if (m_iterating) {
+      m_pending.push_back(std::make_pair(e, false));
+      return m_entities.find(e) != m_entities.end();
+    }
+
     auto ret = m_entities.erase(e);
     return ret > 0;
   }
 
+  bool GlobalSystem::hasChanged(Entity e) const {
+    if (!m_filtered) {
+      return true;
+    }
+
+    uint64_t tick = getLastRunTick();
+
+    for (Store *store : m_filterStores) {
+      if (store->getChangeTick(e) > tick) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
   void GlobalSystem::update(float delta) {
-    /* make a copy so that the entities can be safely removed from the system
-     * without invalidating the iterators.
+    if (m_filtered) {
+      // the stores may have been created after the system
+      m_filterStores.clear();
+
+      for (ComponentType ct : m_filterTypes) {
+        Store *store = getManager()->getStore(ct);
+
+        if (store != nullptr) {
+          m_filterStores.push_back(store);
+        }
+      }
+    }
+
+    if (m_chunkSize > 0) {
+      resolveChunkStores();
+    }
+
+    ThreadPool *pool = getManager()->getThreadPool();
+
+    if (m_parallel && pool != nullptr) {
+      m_snapshot.clear();
+
+      for (Entity e : m_entities) {
+        if (hasChanged(e)) {
+          m_snapshot.push_back(e);
+        }
+      }
+
+      // the buffers of the chunks are reused from one task to the next
+      if (m_threadBuffers.size() <= pool->getThreadCount()) {
+        m_threadBuffers.resize(pool->getThreadCount() + 1);
+      }
+
+      pool->parallelFor(0, m_snapshot.size(), m_grain, [this, delta](std::size_t begin, std::size_t end) {
+        if (m_chunkSize > 0) {
+          updateTask([this, delta, begin, end](ChunkBuffer& buffer) {
+            updateChunks(delta, m_snapshot, begin, end, buffer);
+          });
+          return;
+        }
+
+        for (std::size_t i = begin; i < end; ++i) {
+          updateEntity(delta, m_snapshot[i]);
+        }
+      });
+
+      return;
+    }
+
+    if (m_chunkSize > 0) {
+      /*
+       * the chunks need contiguous entities, so the entities are copied.
+       * The entities that are added or removed during the iteration are
+       * handled at the end.
+       */
+      m_snapshot.clear();
+
+      for (Entity e : m_entities) {
+        if (hasChanged(e)) {
+          m_snapshot.push_back(e);
+        }
+      }
+
+      m_iterating = true;
+      updateChunks(delta, m_snapshot, 0, m_snapshot.size(), m_chunkBuffer);
+      m_iterating = false;
+      applyPending();
+      return;
+    }
+
+    /*
+     * iterate over the live set. The entities that are added or removed
+     * during the iteration are handled at the end.
      */
-    auto copy = getEntities();
-    for (Entity e : copy) {
-      updateEntity(delta, e);
+    m_iterating = true;
+
+    for (Entity e : m_entities) {
+      if (hasChanged(e)) {
+        updateEntity(delta, e);
+      }
     }
+
+    m_iterating = false;
+    applyPending();
   }
 
   void GlobalSystem::updateEntity(float delta, Entity entity) {
     // nothing by default
   }
 
+  void GlobalSystem::updateChunk(float delta, const Chunk& chunk) {
+    for (std::size_t i = 0; i < chunk.getSize(); ++i) {
+      updateEntity(delta, chunk.getEntityAt(i));
+    }
+  }
+
+  std::size_t GlobalSystem::getChunkColumn(ComponentType ct) const {
+    auto it = std::lower_bound(m_chunkTypes.begin(), m_chunkTypes.end(), ct);
+    assert(it != m_chunkTypes.end() && *it == ct);
+    return static_cast<std::size_t>(it - m_chunkTypes.begin());
+  }
+
+  void GlobalSystem::resolveChunkStores() {
+    // the stores may have been created after the system
+    m_chunkStores.clear();
+    m_chunkColumnStores.clear();
+    m_chunkMarks.clear();
+    m_chunkHasColumns = false;
+
+    std::set<ComponentType> writes = getWrittenComponents();
+
+    for (ComponentType ct : m_chunkTypes) {
+      ColumnStoreBase *columnStore = getManager()->getColumnStore(ct);
+      m_chunkStores.push_back(getManager()->getStore(ct));
+      m_chunkColumnStores.push_back(columnStore);
+      m_chunkMarks.push_back(!hasDeclaredAccess() || writes.find(ct) != writes.end());
+      m_chunkHasColumns = m_chunkHasColumns || columnStore != nullptr;
+    }
+  }
+
+  void GlobalSystem::updateChunks(float delta, const std::vector<Entity>& entities, std::size_t begin, std::size_t end, ChunkBuffer& buffer) {
+    std::size_t columns = m_chunkStores.size();
+
+    for (std::size_t first = begin; first < end; first += m_chunkSize) {
+      std::size_t size = std::min(m_chunkSize, end - first);
+      const Entity *chunk = entities.data() + first;
+      buffer.components.resize(columns * size);
+
+      if (m_chunkHasColumns) {
+        buffer.rows.assign(columns * size, ColumnStoreBase::INVALID_ROW);
+      }
+
+      for (std::size_t column = 0; column < columns; ++column) {
+        Component **components = buffer.components.data() + column * size;
+        Store *store = m_chunkStores[column];
+
+        if (store != nullptr) {
+          store->resolve(chunk, size, components, m_chunkMarks[column]);
+          continue;
+        }
+
+        std::fill(components, components + size, nullptr);
+        ColumnStoreBase *columnStore = m_chunkColumnStores[column];
+
+        if (columnStore != nullptr) {
+          std::size_t *rows = buffer.rows.data() + column * size;
+
+          for (std::size_t i = 0; i < size; ++i) {
+            rows[i] = columnStore->find(chunk[i]);
+          }
+        }
+      }
+
+      updateChunk(delta, Chunk(chunk, size, buffer.components.data(), columns, m_chunkHasColumns ? buffer.rows.data() : nullptr));
+    }
+  }
+
+  void GlobalSystem::updateRange(float delta, const std::vector<Entity>& entities, std::size_t begin, std::size_t end, ChunkBuffer& buffer) {
+    if (m_chunkSize > 0) {
+      updateChunks(delta, entities, begin, end, buffer);
+      return;
+    }
+
+    for (std::size_t i = begin; i < end; ++i) {
+      updateEntity(delta, entities[i]);
+    }
+  }
+
+  void GlobalSystem::updateFused(float delta, const std::vector<GlobalSystem *>& systems) {
+    /*
+     * the systems have the same needed components, so they usually have the
+     * same entities. But an entity can be added to or removed from a single
+     * system (by the system itself or directly), and then each system is
+     * updated on its own entities.
+     */
+    for (GlobalSystem *system : systems) {
+      if (system != this && system->m_entities != m_entities) {
+        for (GlobalSystem *other : systems) {
+          other->update(delta);
+        }
+
+        return;
+      }
+    }
+
+    m_snapshot.assign(m_entities.begin(), m_entities.end());
+
+    bool parallel = true;
+
+    for (GlobalSystem *system : systems) {
+      if (system->m_chunkSize > 0) {
+        system->resolveChunkStores();
+      }
+
+      parallel = parallel && system->m_parallel;
+    }
+
+    // the size of a block, in which every system updates the entities
+    std::size_t block = m_chunkSize > 0 ? m_chunkSize : 64;
+
+    ThreadPool *pool = getManager()->getThreadPool();
+
+    if (parallel && pool != nullptr) {
+      if (m_threadBuffers.size() <= pool->getThreadCount()) {
+        m_threadBuffers.resize(pool->getThreadCount() + 1);
+      }
+
+      pool->parallelFor(0, m_snapshot.size(), std::max(m_grain, block), [this, delta, block, &systems](std::size_t begin, std::size_t end) {
+        updateTask([this, delta, block, begin, end, &systems](ChunkBuffer& buffer) {
+          for (std::size_t first = begin; first < end; first += block) {
+            std::size_t last = std::min(end, first + block);
+
+            for (GlobalSystem *system : systems) {
+              system->updateRange(delta, m_snapshot, first, last, buffer);
+            }
+          }
+        });
+      });
+
+      return;
+    }
+
+    for (GlobalSystem *system : systems) {
+      system->m_iterating = true;
+    }
+
+    for (std::size_t first = 0; first < m_snapshot.size(); first += block) {
+      std::size_t last = std::min(m_snapshot.size(), first + block);
+
+      for (GlobalSystem *system : systems) {
+        system->updateRange(delta, m_snapshot, first, last, system->m_chunkBuffer);
+      }
+    }
+
+    for (GlobalSystem *system : systems) {
+      system->m_iterating = false;
+      system->applyPending();
+    }
+  }
+
+  void GlobalSystem::applyPending() {
+    for (auto& change : m_pending) {
+      if (change.second) {
+        m_entities.insert(change.first);
+      } else {
+        m_entities.erase(change.first);
+      }
+    }
+
+    m_pending.clear();
+  }
+
 }
@@ -15,67 +15,591 @@
  */
 #include <es/LocalSystem.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+#include <es/Manager.h>
 
 namespace es {
 
+  bool LocalSystem::addEntity(Entity e) {
+    if (m_positionType == INVALID_COMPONENT) {
+      return false;
+    }
+
+    Store *store = getManager()->getStore(m_positionType);
+    const Component *c = store != nullptr ? store->read(e) : nullptr;
+
+    if (c == nullptr) {
+      return false;
+    }
+
+    int x, y;
+    computeCell(c, x, y);
+    return addLocalEntity(e, x, y);
+  }
+
+  bool LocalSystem::removeEntity(Entity e) {
+    std::size_t position = findMember(e);
+
+    if (position == INVALID_POSITION) {
+      return false;
+    }
+
+    releaseCell(m_members[position].cell);
+    eraseMember(position);
+    m_dirty = true;
+    return true;
+  }
+
+  void LocalSystem::bindPosition(ComponentType ct, float cellSize, PositionFunction position) {
+    assert(ct != INVALID_COMPONENT);
+    assert(cellSize > 0.0f);
+    assert(position);
+    m_cellSize = cellSize;
+    m_position = std::move(position);
+
+    if (m_changes != nullptr) {
+      getManager()->getStore(m_positionType)->destroyChangeList(m_changes);
+      m_changes = nullptr;
+    }
+
+    m_positionType = ct;
+  }
+
+  void LocalSystem::migrate() {
+    if (m_positionType == INVALID_COMPONENT || m_iterating) {
+      return;
+    }
+
+    Store *store = getManager()->getStore(m_positionType);
+
+    if (store == nullptr) {
+      return;
+    }
+
+    // a full rebuild costs the number of members and cells
+    std::size_t budget = m_members.size() + m_offsets.size();
+
+    if (m_changes == nullptr) {
+      // the previous modifications are unknown, check all the members once
+      m_changes = store->createChangeList();
+
+      for (std::size_t position = 0; position < m_members.size(); ++position) {
+        migrateMember(store, position, budget);
+      }
+
+      return;
+    }
+
+    for (std::size_t i = 0; i < m_changes->getSize(); ++i) {
+      uint32_t index = m_changes->getIndexAt(i);
+
+      if (index < m_positions.size() && m_positions[index] != INVALID_POSITION) {
+        migrateMember(store, m_positions[index], budget);
+      }
+    }
+
+    m_changes->clear();
+  }
+
+  void LocalSystem::migrateMember(Store *store, std::size_t position, std::size_t& budget) {
+    const Component *c = store->read(m_members[position].entity);
+
+    if (c == nullptr) {
+      return;
+    }
+
+    int x, y;
+    computeCell(c, x, y);
+
+    std::size_t previous = m_members[position].cell;
+
+    if (findCell(x, y) == previous) {
+      return;
+    }
+
+    moveMember(position, acquireCell(x, y), budget);
+    releaseCell(previous);
+  }
+
+  void LocalSystem::moveMember(std::size_t position, std::size_t cell, std::size_t& budget) {
+    Member& member = m_members[position];
+    std::size_t from = member.cell;
+    member.cell = cell;
+
+    if (m_dirty) {
+      return;
+    }
+
+    std::size_t distance = from < cell ? cell - from : from - cell;
+
+    // the packed array must not change while it is iterated
+    if (m_iterating || distance > budget) {
+      m_dirty = true;
+      return;
+    }
+
+    budget -= distance;
+
+    // a new cell of a sparse grid is empty, at the end of the packed array
+    if (cell + 2 > m_offsets.size()) {
+      m_offsets.resize(cell + 2, m_offsets.back());
+    }
+
+    /*
+     * the entity is swapped with the last (or first) entity of its cell and
+     * the boundary is moved, so that the entity enters the next (or
+     * previous) cell, until it reaches its new cell
+     */
+    std::size_t slot = member.slot;
+
+    for (; from < cell; ++from) {
+      std::size_t last = --m_offsets[from + 1];
+      swapSlots(slot, last);
+      slot = last;
+    }
+
+    for (; from > cell; --from) {
+      std::size_t first = m_offsets[from]++;
+      swapSlots(slot, first);
+      slot = first;
+    }
+  }
+
+  void LocalSystem::swapSlots(std::size_t first, std::size_t second) {
+    if (first == second) {
+      return;
+    }
+
+    std::swap(m_packed[first], m_packed[second]);
+    m_members[m_positions[getEntityIndex(m_packed[first])]].slot = first;
+    m_members[m_positions[getEntityIndex(m_packed[second])]].slot = second;
+  }
+
+  void LocalSystem::computeCell(const Component *c, int& x, int& y) const {
+    float px = 0.0f;
+    float py = 0.0f;
+    m_position(c, px, py);
+    x = computeCellCoordinate(px, m_width);
+    y = computeCellCoordinate(py, m_height);
+  }
+
+  int LocalSystem::computeCellCoordinate(float position, int size) const {
+    float coordinate = std::floor(position / m_cellSize);
+    float min = m_sparse ? static_cast<float>(std::numeric_limits<int>::min()) : 0.0f;
+    float max = m_sparse ? static_cast<float>(std::numeric_limits<int>::max()) : static_cast<float>(size - 1);
+
+    // NaN goes in the first cell
+    if (!(coordinate >= min)) {
+      return static_cast<int>(min);
+    }
+
+    // the float value of INT_MAX is out of the int range
+    if (coordinate >= max) {
+      return m_sparse ? std::numeric_limits<int>::max() : size - 1;
+    }
+
+    return static_cast<int>(coordinate);
+  }
+
   void LocalSystem::update(float delta) {
-    auto copy = getEntities();
-    for (Entity e : copy) {
-      updateEntity(delta, e);
+    migrate();
+
+    if (m_parallel && getManager()->getThreadPool() != nullptr) {
+      updateParallel(delta);
+      return;
     }
+
+    const std::vector<EntityRange>& ranges = getRanges();
+
+    /*
+     * the packed array is not rebuilt during the iteration, even if some
+     * entities are added, removed or moved by updateEntity
+     */
+    m_iterating = true;
+
+    for (const EntityRange& range : ranges) {
+      for (Entity e : range) {
+        updateEntity(delta, e);
+      }
+    }
+
+    m_iterating = false;
   }
 
   void LocalSystem::updateEntity(float delta, Entity entity) {
     // nothing by default
   }
 
+  void LocalSystem::getCellCoordinates(std::size_t cell, int64_t& x, int64_t& y) const {
+    if (m_sparse) {
+      x = static_cast<int32_t>(static_cast<uint32_t>(m_cellKeys[cell] >> 32));
+      y = static_cast<int32_t>(static_cast<uint32_t>(m_cellKeys[cell]));
+    } else {
+      x = static_cast<int64_t>(cell % static_cast<std::size_t>(m_width));
+      y = static_cast<int64_t>(cell / static_cast<std::size_t>(m_width));
+    }
+  }
+
+  std::size_t LocalSystem::getPhase(std::size_t cell) const {
+    int64_t x, y;
+    getCellCoordinates(cell, x, y);
+
+    // the remainders are positive, even for negative coordinates
+    return static_cast<std::size_t>((x % 3 + 3) % 3 + 3 * ((y % 3 + 3) % 3));
+  }
+
+  void LocalSystem::updateParallel(float delta) {
+    getRanges();
+
+    for (std::vector<std::size_t>& cells : m_phases) {
+      cells.clear();
+    }
+
+    for (const auto& span : m_spans) {
+      for (std::size_t cell = span.first; cell <= span.second; ++cell) {
+        if (m_offsets[cell] < m_offsets[cell + 1]) {
+          m_phases[getPhase(cell)].push_back(cell);
+        }
+      }
+    }
+
+    ThreadPool *pool = getManager()->getThreadPool();
+    m_iterating = true;
+
+    for (const std::vector<std::size_t>& cells : m_phases) {
+      pool->parallelFor(0, cells.size(), m_grain, [this, delta, &cells](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+          std::size_t cell = cells[i];
+
+          for (std::size_t k = m_offsets[cell]; k < m_offsets[cell + 1]; ++k) {
+            updateEntity(delta, m_packed[k]);
+          }
+        }
+      });
+    }
+
+    m_iterating = false;
+  }
+
   void LocalSystem::reset(int width, int height) {
     assert(width > 0);
     assert(height > 0);
+    m_sparse = false;
     m_width = width;
     m_height = height;
-    m_entities.clear();
-    m_entities.resize(m_width * m_height);
+    clear();
   }
 
-  const std::set<Entity> LocalSystem::getEntities() const {
-    assert(0 <= m_x && m_x < m_width);
-    assert(0 <= m_y && m_y < m_height);
+  void LocalSystem::reset() {
+    m_sparse = true;
+    m_width = 0;
+    m_height = 0;
+    clear();
+  }
 
+  void LocalSystem::clear() {
+    m_members.clear();
+    m_positions.clear();
+    m_cellIds.clear();
+    m_cellCounts.clear();
+    m_cellKeys.clear();
+    m_freeCells.clear();
+    m_dirty = true;
+  }
+
+  const std::set<Entity> LocalSystem::getEntities() const {
     std::set<Entity> ret;
 
-    int xmin = (m_x - 1 >= 0) ? m_x - 1 : m_x;
-    int xmax = (m_x + 1 < m_width) ? m_x + 1 : m_x;
-    int ymin = (m_y - 1 >= 0) ? m_y - 1 : m_y;
-    int ymax = (m_y + 1 < m_height) ? m_y + 1 : m_y;
+    for (const Member& member : m_members) {
+      int64_t x, y;
+      getCellCoordinates(member.cell, x, y);
 
-    for (int x = xmin; x <= xmax; ++x) {
-      for (int y = ymin; y <= ymax; ++y) {
-        auto& set = m_entities[getIndex(x, y)];
-        ret.insert(set.begin(), set.end());
+      for (const Focus& focus : m_foci) {
+        if (std::abs(x - focus.x) <= focus.radius && std::abs(y - focus.y) <= focus.radius) {
+          ret.insert(member.entity);
+          break;
+        }
       }
     }
 
-    return std::move(ret);
+    return ret;
+  }
+
+  const std::vector<EntityRange>& LocalSystem::getRanges() {
+    // the ranges are being iterated, they must not change
+    if (m_iterating) {
+      return m_ranges;
+    }
+
+    if (m_dirty) {
+      rebuild();
+    }
+
+    computeRanges();
+    return m_ranges;
   }
 
   bool LocalSystem::addLocalEntity(Entity e, int x, int y) {
-    assert(0 <= x && x < m_width);
-    assert(0 <= y && y < m_height);
+    assert(m_sparse || (0 <= x && x < m_width));
+    assert(m_sparse || (0 <= y && y < m_height));
+
+    std::size_t position = findMember(e);
+
+    if (position != INVALID_POSITION) {
+      std::size_t previous = m_members[position].cell;
+
+      if (previous == findCell(x, y)) {
+        return false;
+      }
+
+      std::size_t budget = m_members.size() + m_offsets.size();
+      moveMember(position, acquireCell(x, y), budget);
+      releaseCell(previous);
+      return true;
+    }
+
+    std::size_t cell = acquireCell(x, y);
 
-    auto& set = m_entities[getIndex(x, y)];
-    auto ret = set.insert(e);
-    return ret.second;
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_positions.size()) {
+      m_positions.resize(index + 1, INVALID_POSITION);
+    }
+
+    m_positions[index] = m_members.size();
+    m_members.push_back({ e, cell, INVALID_POSITION });
+    m_dirty = true;
+    return true;
   }
 
   bool LocalSystem::removeLocalEntity(Entity e, int x, int y) {
-    assert(0 <= x && x < m_width);
-    assert(0 <= y && y < m_height);
+    assert(m_sparse || (0 <= x && x < m_width));
+    assert(m_sparse || (0 <= y && y < m_height));
+
+    std::size_t position = findMember(e);
 
-    auto& set = m_entities[getIndex(x, y)];
-    auto ret = set.erase(e);
-    return ret > 0;
+    if (position == INVALID_POSITION || m_members[position].cell != findCell(x, y)) {
+      return false;
+    }
+
+    releaseCell(m_members[position].cell);
+    eraseMember(position);
+    m_dirty = true;
+    return true;
   }
 
+  std::size_t LocalSystem::findMember(Entity e) const {
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_positions.size()) {
+      return INVALID_POSITION;
+    }
+
+    std::size_t position = m_positions[index];
+
+    if (position == INVALID_POSITION || m_members[position].entity != e) {
+      return INVALID_POSITION;
+    }
+
+    return position;
+  }
+
+  void LocalSystem::eraseMember(std::size_t position) {
+    std::size_t last = m_members.size() - 1;
+    m_positions[getEntityIndex(m_members[position].entity)] = INVALID_POSITION;
+
+    if (position != last) {
+      m_members[position] = m_members[last];
+      m_positions[getEntityIndex(m_members[position].entity)] = position;
+    }
+
+    m_members.pop_back();
+  }
+
+  std::size_t LocalSystem::findCell(int x, int y) const {
+    if (!m_sparse) {
+      return getIndex(x, y);
+    }
+
+    auto it = m_cellIds.find(getKey(x, y));
+    return it == m_cellIds.end() ? INVALID_POSITION : it->second;
+  }
+
+  std::size_t LocalSystem::acquireCell(int x, int y) {
+    if (!m_sparse) {
+      return getIndex(x, y);
+    }
+
+    auto ret = m_cellIds.insert(std::make_pair(getKey(x, y), INVALID_POSITION));
+
+    if (ret.second) {
+      // a new cell, reuse the id of a cell that has been reclaimed
+      if (m_freeCells.empty()) {
+        ret.first->second = m_cellCounts.size();
+        m_cellCounts.push_back(0);
+        m_cellKeys.push_back(0);
+      } else {
+        ret.first->second = m_freeCells.back();
+        m_freeCells.pop_back();
+      }
+
+      m_cellKeys[ret.first->second] = ret.first->first;
+    }
+
+    std::size_t cell = ret.first->second;
+    m_cellCounts[cell]++;
+    return cell;
+  }
+
+  void LocalSystem::releaseCell(std::size_t cell) {
+    if (!m_sparse) {
+      return;
+    }
+
+    assert(m_cellCounts[cell] > 0);
+
+    if (--m_cellCounts[cell] > 0) {
+      return;
+    }
+
+    // the last entity left the cell, reclaim it
+    m_cellIds.erase(m_cellKeys[cell]);
+    m_freeCells.push_back(cell);
+  }
+
+  void LocalSystem::rebuild() {
+    /*
+     * counting sort of the entities by cell
+     */
+    std::size_t cells = m_sparse ? m_cellCounts.size() : getIndex(0, m_height);
+    m_offsets.assign(cells + 1, 0);
+
+    for (const Member& member : m_members) {
+      m_offsets[member.cell + 1]++;
+    }
+
+    for (std::size_t cell = 0; cell < cells; ++cell) {
+      m_offsets[cell + 1] += m_offsets[cell];
+    }
+
+    m_cursors.assign(m_offsets.begin(), m_offsets.end() - 1);
+    m_packed.resize(m_members.size());
+
+    for (Member& member : m_members) {
+      member.slot = m_cursors[member.cell]++;
+      m_packed[member.slot] = member.entity;
+    }
+
+    m_dirty = false;
+  }
+
+  void LocalSystem::addSpan(std::size_t first, std::size_t last) {
+    m_spans.push_back(std::make_pair(first, last));
+  }
+
+  void LocalSystem::addSparseSpans(const Focus& focus) {
+    // 64-bit coordinates, so that the neighbourhood does not overflow
+    int64_t xmin = std::max(int64_t(focus.x) - focus.radius, int64_t(std::numeric_limits<int>::min()));
+    int64_t xmax = std::min(int64_t(focus.x) + focus.radius, int64_t(std::numeric_limits<int>::max()));
+    int64_t ymin = std::max(int64_t(focus.y) - focus.radius, int64_t(std::numeric_limits<int>::min()));
+    int64_t ymax = std::min(int64_t(focus.y) + focus.radius, int64_t(std::numeric_limits<int>::max()));
+
+    uint64_t width = static_cast<uint64_t>(xmax - xmin + 1);
+    uint64_t height = static_cast<uint64_t>(ymax - ymin + 1);
+
+    if (width > m_cellIds.size() / height) {
+      // the neighbourhood has more cells than the grid, check the allocated cells
+      for (auto& entry : m_cellIds) {
+        int64_t x = static_cast<int32_t>(static_cast<uint32_t>(entry.first >> 32));
+        int64_t y = static_cast<int32_t>(static_cast<uint32_t>(entry.first));
+
+        if (xmin <= x && x <= xmax && ymin <= y && y <= ymax) {
+          addSpan(entry.second, entry.second);
+        }
+      }
+
+      return;
+    }
+
+    for (int64_t y = ymin; y <= ymax; ++y) {
+      for (int64_t x = xmin; x <= xmax; ++x) {
+        std::size_t cell = findCell(static_cast<int>(x), static_cast<int>(y));
+
+        if (cell != INVALID_POSITION) {
+          addSpan(cell, cell);
+        }
+      }
+    }
+  }
+
+  void LocalSystem::computeRanges() {
+    m_ranges.clear();
+    m_spans.clear();
+
+    if (m_offsets.empty()) {
+      return;
+    }
+
+    for (const Focus& focus : m_foci) {
+      if (m_sparse) {
+        addSparseSpans(focus);
+        continue;
+      }
+
+      int64_t xmin = std::max(int64_t(focus.x) - focus.radius, int64_t(0));
+      int64_t xmax = std::min(int64_t(focus.x) + focus.radius, int64_t(m_width) - 1);
+      int64_t ymin = std::max(int64_t(focus.y) - focus.radius, int64_t(0));
+      int64_t ymax = std::min(int64_t(focus.y) + focus.radius, int64_t(m_height) - 1);
+
+      for (int64_t y = ymin; xmin <= xmax && y <= ymax; ++y) {
+        // the cells of a row are contiguous, so they make a single span
+        addSpan(getIndex(static_cast<int>(xmin), static_cast<int>(y)), getIndex(static_cast<int>(xmax), static_cast<int>(y)));
+      }
+    }
+
+    if (m_spans.empty()) {
+      return;
+    }
+
+    /*
+     * merge the overlapping and adjacent spans, the entities of adjacent
+     * cells are contiguous in the packed array
+     */
+    std::sort(m_spans.begin(), m_spans.end());
+
+    std::size_t count = 0;
+
+    for (const auto& span : m_spans) {
+      if (count > 0 && span.first <= m_spans[count - 1].second + 1) {
+        m_spans[count - 1].second = std::max(m_spans[count - 1].second, span.second);
+      } else {
+        m_spans[count++] = span;
+      }
+    }
+
+    m_spans.resize(count);
+
+    for (const auto& span : m_spans) {
+      addRange(span.first, span.second);
+    }
+  }
+
+  void LocalSystem::addRange(std::size_t first, std::size_t last) {
+    std::size_t begin = m_offsets[first];
+    std::size_t end = m_offsets[last + 1];
+
+    if (begin < end) {
+      m_ranges.push_back(EntityRange(m_packed.data() + begin, m_packed.data() + end));
+    }
+  }
+
+  const std::size_t LocalSystem::INVALID_POSITION;
+  const std::size_t LocalSystem::PHASE_COUNT;
+
 }
@@ -17,58 +17,237 @@
 
 #include <cassert>
 #include <algorithm>
+#include <atomic>
+#include <functional>
 
+#include <es/GlobalSystem.h>
 #include <es/System.h>
 #include <es/Support.h>
 
 namespace es {
 
   Manager::~Manager() {
-    for (auto store : m_stores) {
-      // TODO: delete the content of the store?
-      delete store.second;
+    for (Store *store : m_stores) {
+      // the content of the store is deleted only if the store owns it
+      delete store;
+    }
+
+    for (ColumnStoreBase *store : m_columnStores) {
+      delete store;
     }
   }
 
   Entity Manager::createEntity() {
-    Entity e = m_next++;
+    if (m_concurrentUpdate) {
+      return m_commands.createEntity();
+    }
+
+    uint32_t index;
+
+    if (m_freeIndices.empty()) {
+      index = m_nextIndex++;
+      m_entities.resize(index + 1);
+    } else {
+      index = m_freeIndices.back();
+      m_freeIndices.pop_back();
+    }
+
+    EntityData& data = m_entities[index];
+    assert(!data.alive);
+    data.alive = true;
+
+    Entity e = makeEntity(index, data.generation);
     assert(e != INVALID_ENTITY);
-#ifdef COMPILER_IS_NOT_CXX11_READY
-    auto ret = m_entities.insert(std::make_pair(e, std::set<ComponentType>()));
-#else
-    auto ret = m_entities.emplace(e, std::set<ComponentType>());
-#endif
-    assert(ret.second);
+
+    if (m_archetypesEnabled) {
+      moveToArchetype(e, data);
+    }
+
     return e;
   }
 
+  Entity Manager::reserveEntity() {
+    /*
+     * the index is never recycled, so that the reservation does not touch
+     * the data of the entities
+     */
+    uint32_t index = m_nextIndex++;
+    return makeEntity(index, 0);
+  }
+
+  void Manager::createReservedEntity(Entity e) {
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_entities.size()) {
+      m_entities.resize(index + 1);
+    }
+
+    EntityData& data = m_entities[index];
+    assert(!data.alive);
+    assert(data.generation == getEntityGeneration(e));
+    data.alive = true;
+
+    if (m_archetypesEnabled) {
+      moveToArchetype(e, data);
+    }
+  }
+
   bool Manager::destroyEntity(Entity e) {
-    auto count = m_entities.erase(e);
-    return count > 0;
+    if (m_concurrentUpdate) {
+      if (e == INVALID_ENTITY) {
+        return false;
+      }
+
+      m_commands.destroyEntity(e);
+      return true;
+    }
+
+    EntityData *data = getEntityData(e);
+
+    if (data == nullptr) {
+      return false;
+    }
+
+    for (std::size_t index = 0; index < MAX_COMPONENT_TYPES; ++index) {
+      if (!data->signature.test(index)) {
+        continue;
+      }
+
+      Store *store = m_stores[index];
+
+      if (store == nullptr) {
+        assert(m_columnStores[index]);
+        m_columnStores[index]->remove(e);
+      } else if (!store->destroy(e)) {
+        store->remove(e);
+      }
+
+      notify(index, ComponentEvent::REMOVED, e);
+    }
+
+    for (auto& sys : m_systems) {
+      sys.system->removeEntity(e);
+    }
+
+    removeFromArchetype(*data);
+    data->signature.reset();
+    data->subscriptionVersion = 0;
+    data->alive = false;
+    data->generation++;
+    m_freeIndices.push_back(getEntityIndex(e));
+    return true;
   }
 
   std::set<Entity> Manager::getEntities() const {
     std::set<Entity> ret;
 
-    for (auto entity : m_entities) {
-      ret.insert(entity.first);
+    for (std::size_t index = 1; index < m_entities.size(); ++index) {
+      const EntityData& data = m_entities[index];
+
+      if (data.alive) {
+        ret.insert(makeEntity(static_cast<uint32_t>(index), data.generation));
+      }
     }
 
-    return std::move(ret);
+    return ret;
+  }
+
+  bool Manager::registerComponent(ComponentType ct, const char *name) {
+    std::size_t index = Registry::getComponentRegistry().registerType(ct, name);
+    assert(index != INVALID_TYPE_INDEX);
+    return index != INVALID_TYPE_INDEX;
   }
 
   Store *Manager::getStore(ComponentType ct) {
-    auto it = m_stores.find(ct);
-    return it == m_stores.end() ? nullptr : it->second;
+    if (ct == INVALID_COMPONENT) {
+      return nullptr;
+    }
+
+    return getStoreAt(Registry::getComponentRegistry().getIndex(ct));
+  }
+
+  ColumnStoreBase *Manager::getColumnStore(ComponentType ct) {
+    if (ct == INVALID_COMPONENT) {
+      return nullptr;
+    }
+
+    return getColumnStoreAt(Registry::getComponentRegistry().getIndex(ct));
   }
 
   bool Manager::createStoreFor(ComponentType ct) {
-    auto ret = m_stores.insert(std::make_pair(ct, new Store));
-    return ret.second;
+    std::size_t index = Registry::getComponentRegistry().registerType(ct);
+
+    if (index == INVALID_TYPE_INDEX || m_stores[index] != nullptr || m_columnStores[index] != nullptr) {
+      return false;
+    }
+
+    Store *store = new Store;
+    store->setClock(&m_tick);
+    m_stores[index] = store;
+    return true;
+  }
+
+  bool Manager::createStoreFor(ComponentType ct, Pool *pool) {
+    assert(pool);
+    std::size_t index = Registry::getComponentRegistry().registerType(ct);
+
+    if (index == INVALID_TYPE_INDEX || m_stores[index] != nullptr || m_columnStores[index] != nullptr) {
+      return false;
+    }
+
+    Store *store = new Store(pool);
+    store->setClock(&m_tick);
+    m_stores[index] = store;
+    return true;
+  }
+
+  bool Manager::createColumnStoreAt(std::size_t index, ColumnStoreBase *store) {
+    assert(store);
+
+    if (index == INVALID_TYPE_INDEX || m_stores[index] != nullptr || m_columnStores[index] != nullptr) {
+      return false;
+    }
+
+    m_columnStores[index] = store;
+    m_columnSignature.set(index);
+    return true;
+  }
+
+  void Manager::attachColumnComponentAt(Entity e, std::size_t index) {
+    EntityData *data = getEntityData(e);
+    assert(data);
+
+    data->signature.set(index);
+
+    if (m_archetypesEnabled) {
+      moveToArchetype(e, *data);
+    }
+
+    notify(index, ComponentEvent::ADDED, e);
+  }
+
+  bool Manager::removeColumnComponentAt(Entity e, std::size_t index) {
+    assert(!m_concurrentUpdate);
+
+    ColumnStoreBase *store = getColumnStoreAt(index);
+    EntityData *data = getEntityData(e);
+
+    if (store == nullptr || data == nullptr || !store->remove(e)) {
+      return false;
+    }
+
+    data->signature.reset(index);
+
+    if (m_archetypesEnabled) {
+      moveToArchetype(e, *data);
+    }
+
+    notify(index, ComponentEvent::REMOVED, e);
+    return true;
   }
 
   Component *Manager::getComponent(Entity e, ComponentType ct) {
-    if (e == INVALID_ENTITY || ct == INVALID_COMPONENT) {
+    if (e == INVALID_ENTITY) {
       return nullptr;
     }
 
@@ -81,150 +260,977 @@ namespace es {
     return store->get(e);
   }
 
+  Component *Manager::writeComponent(Entity e, ComponentType ct) {
+    if (ct == INVALID_COMPONENT) {
+      return nullptr;
+    }
+
+    return writeComponentAt(e, Registry::getComponentRegistry().getIndex(ct));
+  }
+
+  Component *Manager::writeComponentAt(Entity e, std::size_t index) {
+    if (e == INVALID_ENTITY) {
+      return nullptr;
+    }
+
+    Store *store = getStoreAt(index);
+
+    if (store == nullptr) {
+      return nullptr;
+    }
+
+    Component *c = store->write(e);
+
+    if (c != nullptr) {
+      notify(index, ComponentEvent::CHANGED, e);
+    }
+
+    return c;
+  }
+
+  const Component *Manager::readComponent(Entity e, ComponentType ct) {
+    if (e == INVALID_ENTITY) {
+      return nullptr;
+    }
+
+    Store *store = getStore(ct);
+
+    if (store == nullptr) {
+      return nullptr;
+    }
+
+    return store->read(e);
+  }
+
   bool Manager::addComponent(Entity e, ComponentType ct, Component *c) {
-    if (e == INVALID_ENTITY || ct == INVALID_COMPONENT) {
+    if (ct == INVALID_COMPONENT) {
       return false;
     }
 
-    Store *store = getStore(ct);
+    return addComponentAt(e, Registry::getComponentRegistry().getIndex(ct), c);
+  }
+
+  bool Manager::addComponentAt(Entity e, std::size_t index, Component *c, CommandBuffer::Deleter deleter) {
+    if (e == INVALID_ENTITY) {
+      return false;
+    }
+
+    Store *store = getStoreAt(index);
 
     if (store == nullptr) {
       return false;
     }
 
+    if (m_concurrentUpdate) {
+      m_commands.addComponent(e, Registry::getComponentRegistry().getType(index), c, deleter);
+      return true;
+    }
+
     /*
      * associate the component type to the entity
      */
-    auto it = m_entities.find(e);
+    EntityData *data = getEntityData(e);
 
-    if (it == m_entities.end()) {
+    if (data == nullptr) {
       // this probably indicates that the entity has not been created here
       return false;
     }
 
-    it->second.insert(ct);
-    return store->add(e, c);
+    if (!store->add(e, c)) {
+      return false;
+    }
+
+    data->signature.set(index);
+
+    if (m_archetypesEnabled) {
+      moveToArchetype(e, *data);
+    }
+
+    notify(index, ComponentEvent::ADDED, e);
+    return true;
   }
 
   Component *Manager::extractComponent(Entity e, ComponentType ct) {
-    if (e == INVALID_ENTITY || ct == INVALID_COMPONENT) {
+    if (ct == INVALID_COMPONENT) {
       return nullptr;
     }
 
-    Store *store = getStore(ct);
+    return extractComponentAt(e, Registry::getComponentRegistry().getIndex(ct));
+  }
+
+  Component *Manager::extractComponentAt(Entity e, std::size_t index) {
+    if (e == INVALID_ENTITY) {
+      return nullptr;
+    }
+
+    Store *store = getStoreAt(index);
 
     if (store == nullptr) {
       return nullptr;
     }
 
+    // the memory of the component belongs to the pool, see destroyComponent
+    assert(!store->ownsComponents());
+    assert(!m_concurrentUpdate);
+
+    if (store->ownsComponents()) {
+      return nullptr;
+    }
+
     /*
      * de-associate the component type to the entity
      */
-    auto it = m_entities.find(e);
-    if (it == m_entities.end()) {
+    EntityData *data = getEntityData(e);
+    if (data == nullptr) {
       // this probably indicates that the entity has already been destroyed
       return nullptr;
     }
-    it->second.erase(ct);
-
     Component *c = store->get(e);
+
+    if (c == nullptr) {
+      return nullptr;
+    }
+
     store->remove(e);
+    data->signature.reset(index);
+
+    if (m_archetypesEnabled) {
+      moveToArchetype(e, *data);
+    }
+
+    notify(index, ComponentEvent::REMOVED, e);
     return c;
   }
 
-  int Manager::subscribeEntityToSystems(Entity e, std::set<ComponentType> components) {
+  bool Manager::destroyComponent(Entity e, ComponentType ct) {
+    if (ct == INVALID_COMPONENT) {
+      return false;
+    }
+
+    return destroyComponentAt(e, Registry::getComponentRegistry().getIndex(ct));
+  }
+
+  bool Manager::destroyComponentAt(Entity e, std::size_t index) {
     if (e == INVALID_ENTITY) {
-      return 0;
+      return false;
     }
 
-    int n = 0;
+    Store *store = getStoreAt(index);
 
-    for (auto& sys : m_systems) {
-      const std::set<ComponentType> needed = sys->getNeededComponents();
-      if (std::includes(components.begin(), components.end(), needed.begin(), needed.end())) {
-        sys->addEntity(e);
-        n++;
+    if (store == nullptr || !store->ownsComponents()) {
+      return false;
+    }
+
+    if (m_concurrentUpdate) {
+      return m_commands.removeComponent(e, Registry::getComponentRegistry().getType(index));
+    }
+
+    EntityData *data = getEntityData(e);
+    if (data == nullptr) {
+      return false;
+    }
+    if (!store->destroy(e)) {
+      return false;
+    }
+
+    data->signature.reset(index);
+
+    if (m_archetypesEnabled) {
+      moveToArchetype(e, *data);
+    }
+
+    notify(index, ComponentEvent::REMOVED, e);
+    return true;
+  }
+
+  void Manager::markChanged(Entity e, ComponentType ct) {
+    if (ct == INVALID_COMPONENT) {
+      return;
+    }
+
+    markChangedAt(e, Registry::getComponentRegistry().getIndex(ct));
+  }
+
+  void Manager::markChangedAt(Entity e, std::size_t index) {
+    if (e == INVALID_ENTITY) {
+      return;
+    }
+
+    Store *store = getStoreAt(index);
+
+    if (store != nullptr) {
+      store->mark(e);
+    }
+
+    notify(index, ComponentEvent::CHANGED, e);
+  }
+
+  void Manager::registerObserver(ComponentType ct, ComponentEvent event, ComponentObserver observer) {
+    registerObserverAt(Registry::getComponentRegistry().registerType(ct), event, observer);
+  }
+
+  void Manager::registerObserverAt(std::size_t index, ComponentEvent event, ComponentObserver observer) {
+    assert(observer);
+
+    if (index == INVALID_TYPE_INDEX) {
+      return;
+    }
+
+    // the lists are being traversed, the observer is added after the dispatch
+    if (m_observersDispatching) {
+      m_pendingObservers.push_back(PendingObserver{ index, event, observer });
+      return;
+    }
+
+    // allocated once, so that the table is never moved during a dispatch
+    if (m_observers.empty()) {
+      m_observers.resize(MAX_COMPONENT_TYPES);
+    }
+
+    m_observers[index].observers[static_cast<std::size_t>(event)].push_back(observer);
+  }
+
+  void Manager::notify(std::size_t index, ComponentEvent event, Entity e) {
+    // the table is not modified during the update of the systems
+    if (index >= m_observers.size()) {
+      return;
+    }
+
+    ObserverData& data = m_observers[index];
+    std::size_t kind = static_cast<std::size_t>(event);
+
+    if (data.observers[kind].empty()) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_observersMutex);
+    data.pending[kind].push_back(e);
+  }
+
+  void Manager::dispatchComponentEvents() {
+    std::vector<Entity> entities;
+    m_observersDispatching = true;
+
+    for (std::size_t index = 0; index < m_observers.size(); ++index) {
+      ObserverData& data = m_observers[index];
+
+      for (std::size_t kind = 0; kind < 3; ++kind) {
+        if (data.pending[kind].empty()) {
+          continue;
+        }
+
+        /*
+         * the changes made by the observers are delivered at the next
+         * synchronization point
+         */
+        entities.clear();
+        std::swap(entities, data.pending[kind]);
+        std::sort(entities.begin(), entities.end());
+        entities.erase(std::unique(entities.begin(), entities.end()), entities.end());
+
+        ComponentType ct = Registry::getComponentRegistry().getType(index);
+        std::vector<ComponentObserver>& observers = data.observers[kind];
+        std::size_t kept = 0;
+
+        for (std::size_t i = 0; i < observers.size(); ++i) {
+          if (observers[i](ct, static_cast<ComponentEvent>(kind), entities) == EventStatus::KEEP) {
+            if (kept != i) {
+              observers[kept] = std::move(observers[i]);
+            }
+
+            kept++;
+          }
+        }
+
+        observers.resize(kept);
+      }
+    }
+
+    m_observersDispatching = false;
+
+    // the observers registered during the dispatch are notified from the next one
+    std::vector<PendingObserver> pending;
+    std::swap(pending, m_pendingObservers);
+
+    for (auto& item : pending) {
+      registerObserverAt(item.index, item.event, std::move(item.observer));
+    }
+  }
+
+  void Manager::enableArchetypes() {
+    if (m_archetypesEnabled) {
+      return;
+    }
+
+    m_archetypesEnabled = true;
+
+    for (std::size_t index = 1; index < m_entities.size(); ++index) {
+      EntityData& data = m_entities[index];
+
+      if (data.alive) {
+        moveToArchetype(makeEntity(static_cast<uint32_t>(index), data.generation), data);
+      }
+    }
+  }
+
+  std::vector<Archetype *> Manager::getArchetypes(const std::set<ComponentType>& needed) {
+    ComponentSignature signature = getSignature(needed);
+    std::vector<Archetype *> ret;
+
+    for (auto& archetype : m_archetypes) {
+      if (archetype->getSize() > 0 && (archetype->getSignature() & signature) == signature) {
+        ret.push_back(archetype.get());
+      }
+    }
+
+    return ret;
+  }
+
+  Archetype *Manager::getArchetype(const ComponentSignature& signature) {
+    auto it = m_archetypesBySignature.find(signature);
+
+    if (it != m_archetypesBySignature.end()) {
+      return it->second;
+    }
+
+    Archetype *archetype = new Archetype(signature);
+    m_archetypes.push_back(std::unique_ptr<Archetype>(archetype));
+    m_archetypesBySignature.insert(std::make_pair(signature, archetype));
+    return archetype;
+  }
+
+  void Manager::moveToArchetype(Entity e, EntityData& data) {
+    // the components stored in columns are not in the archetypes
+    ComponentSignature signature = data.signature & ~m_columnSignature;
+
+    Archetype *from = data.archetype;
+    Archetype *to = getArchetype(signature);
+
+    if (from == to) {
+      return;
+    }
+
+    std::size_t row = to->addRow(e);
+
+    /*
+     * the columns are ordered by the index of the component types, so the
+     * two tables are walked in parallel. Only the components that were not
+     * in the previous table are taken from the stores.
+     */
+    std::size_t fromColumn = 0;
+    std::size_t toColumn = 0;
+
+    for (std::size_t index = 0; index < MAX_COMPONENT_TYPES; ++index) {
+      bool inFrom = from != nullptr && from->getSignature().test(index);
+      bool inTo = signature.test(index);
+
+      if (inTo) {
+        Component *c = nullptr;
+
+        if (inFrom) {
+          c = from->getComponentAt<Component>(fromColumn, data.row);
+        } else {
+          // moving the entity does not modify its components
+          assert(m_stores[index]);
+          c = const_cast<Component *>(m_stores[index]->read(e));
+        }
+
+        to->setComponentAt(toColumn++, row, c);
+      }
+
+      if (inFrom) {
+        fromColumn++;
+      }
+    }
+
+    removeFromArchetype(data);
+    data.archetype = to;
+    data.row = row;
+  }
+
+  void Manager::removeFromArchetype(EntityData& data) {
+    if (data.archetype == nullptr) {
+      return;
+    }
+
+    Entity moved = data.archetype->removeRow(data.row);
+
+    if (moved != INVALID_ENTITY) {
+      m_entities[getEntityIndex(moved)].row = data.row;
+    }
+
+    data.archetype = nullptr;
+    data.row = 0;
+  }
+
+  ComponentSignature Manager::getSignature(const std::set<ComponentType>& components) {
+    Registry& registry = Registry::getComponentRegistry();
+    ComponentSignature signature;
+
+    for (auto ct : components) {
+      std::size_t index = registry.registerType(ct);
+      assert(index != INVALID_TYPE_INDEX);
+
+      if (index != INVALID_TYPE_INDEX) {
+        signature.set(index);
+      }
+    }
+
+    return signature;
+  }
+
+  const std::vector<std::size_t>& Manager::getMatchingSystems(const ComponentSignature& signature) {
+    auto it = m_subscriptions.find(signature);
+
+    if (it != m_subscriptions.end()) {
+      return it->second;
+    }
+
+    std::vector<std::size_t> matching;
+
+    for (std::size_t i = 0; i < m_systems.size(); ++i) {
+      const ComponentSignature& needed = m_systems[i].needed;
+
+      if ((signature & needed) == needed) {
+        matching.push_back(i);
+      }
+    }
+
+    // the references to the elements of an unordered_map stay valid
+    return m_subscriptions.insert(std::make_pair(signature, std::move(matching))).first->second;
+  }
+
+  int Manager::subscribe(Entity e, const ComponentSignature& signature, EntityData *data) {
+    const std::vector<std::size_t>& current = getMatchingSystems(signature);
+
+    if (data != nullptr && data->subscriptionVersion == m_systemsVersion) {
+      /*
+       * the entity is already subscribed to the systems of its previous
+       * signature, only apply the difference
+       */
+      if (data->subscription != signature) {
+        const std::vector<std::size_t>& previous = getMatchingSystems(data->subscription);
+        auto prev = previous.begin();
+        auto curr = current.begin();
+
+        while (prev != previous.end() || curr != current.end()) {
+          if (curr == current.end() || (prev != previous.end() && *prev < *curr)) {
+            m_systems[*prev].system->removeEntity(e);
+            ++prev;
+          } else if (prev == previous.end() || *curr < *prev) {
+            m_systems[*curr].system->addEntity(e);
+            ++curr;
+          } else {
+            ++prev;
+            ++curr;
+          }
+        }
+
+        data->subscription = signature;
+      }
+
+      return static_cast<int>(current.size());
+    }
+
+    auto curr = current.begin();
+
+    for (std::size_t i = 0; i < m_systems.size(); ++i) {
+      if (curr != current.end() && *curr == i) {
+        m_systems[i].system->addEntity(e);
+        ++curr;
       } else {
-        sys->removeEntity(e);
+        m_systems[i].system->removeEntity(e);
       }
     }
 
-    return n;
+    if (data != nullptr) {
+      data->subscription = signature;
+      data->subscriptionVersion = m_systemsVersion;
+    }
+
+    return static_cast<int>(current.size());
+  }
+
+  void Manager::invalidateSubscriptions() {
+    m_subscriptions.clear();
+    m_systemsVersion++;
+  }
+
+  int Manager::subscribeEntityToSystems(Entity e, std::set<ComponentType> components) {
+    assert(!m_concurrentUpdate);
+
+    if (e == INVALID_ENTITY) {
+      return 0;
+    }
+
+    return subscribe(e, getSignature(components), getEntityData(e));
   }
 
   int Manager::subscribeEntityToSystems(Entity e) {
-    auto it = m_entities.find(e);
+    if (m_concurrentUpdate) {
+      m_commands.subscribeEntity(e);
+      return 0;
+    }
+
+    EntityData *data = getEntityData(e);
 
-    if (it == m_entities.end()) {
+    if (data == nullptr) {
       return 0;
     }
 
-    return subscribeEntityToSystems(e, it->second);
+    return subscribe(e, data->signature, data);
   }
 
 
   bool Manager::addSystem(std::shared_ptr<System> sys) {
     if (sys) {
-      m_systems.push_back(sys);
+      SystemData data;
+      data.system = sys;
+      data.needed = getSignature(sys->getNeededComponents());
+      data.global = nullptr;
+      data.follower = false;
+      data.declared = false;
+      data.predecessors = 0;
+      m_systems.push_back(data);
+      m_scheduleNeeded = true;
+      invalidateSubscriptions();
     }
 
     return true;
   }
 
   void Manager::initSystems() {
-    std::sort(m_systems.begin(), m_systems.end(), [](const std::shared_ptr<System>& lhs, const std::shared_ptr<System>& rhs) {
-      return lhs->getPriority() < rhs->getPriority();
+    std::sort(m_systems.begin(), m_systems.end(), [](const SystemData& lhs, const SystemData& rhs) {
+      return lhs.system->getPriority() < rhs.system->getPriority();
     });
 
+    invalidateSubscriptions();
+
     for (auto& sys : m_systems) {
-      sys->init();
+      sys.system->init();
+    }
+
+    computeSchedule();
+  }
+
+  void Manager::setThreadCount(unsigned count) {
+    if (count == 0) {
+      m_threadPool.reset();
+    } else {
+      m_threadPool.reset(new ThreadPool(count));
     }
   }
 
   void Manager::updateSystems(float delta) {
+    if (m_scheduleNeeded) {
+      computeSchedule();
+    }
+
+    runSystems(&System::preUpdate, delta, false);
+    synchronize();
+    runSystems(&System::update, delta, true);
+    synchronize();
+    runSystems(&System::postUpdate, delta, false);
+    synchronize();
+  }
+
+  void Manager::synchronize() {
+    m_commands.apply();
+    dispatchComponentEvents();
+    dispatchQueuedEvents();
+  }
+
+  bool Manager::conflicts(const SystemData& lhs, const SystemData& rhs) {
+    if (!lhs.declared || !rhs.declared) {
+      return true;
+    }
+
+    return (lhs.writes & (rhs.reads | rhs.writes)).any() || (rhs.writes & lhs.reads).any();
+  }
+
+  void Manager::computeSchedule() {
     for (auto& sys : m_systems) {
-      sys->preUpdate(delta);
+      sys.declared = sys.system->hasDeclaredAccess();
+      sys.reads = getSignature(sys.system->getReadComponents());
+      sys.writes = getSignature(sys.system->getWrittenComponents());
+      sys.predecessors = 0;
+      sys.successors.clear();
+    }
+
+    /*
+     * the systems are sorted by priority. Only the systems with the same
+     * priority may overlap: the conflicting ones are ordered, and all the
+     * systems of a priority wait for all the systems of the previous
+     * priority (the barrier implies the order with the other priorities)
+     */
+    std::size_t count = m_systems.size();
+
+    for (std::size_t i = 0; i < count; ++i) {
+      int priority = m_systems[i].system->getPriority();
+      std::size_t j = i + 1;
+
+      for (; j < count && m_systems[j].system->getPriority() == priority; ++j) {
+        if (conflicts(m_systems[i], m_systems[j])) {
+          m_systems[i].successors.push_back(j);
+          m_systems[j].predecessors++;
+        }
+      }
+
+      if (j == count) {
+        continue;
+      }
+
+      int next = m_systems[j].system->getPriority();
+
+      for (; j < count && m_systems[j].system->getPriority() == next; ++j) {
+        m_systems[i].successors.push_back(j);
+        m_systems[j].predecessors++;
+      }
     }
 
+    computeFusion();
+    m_scheduleNeeded = false;
+  }
+
+  void Manager::computeFusion() {
     for (auto& sys : m_systems) {
-      sys->update(delta);
+      sys.global = nullptr;
+      sys.fused.clear();
+      sys.follower = false;
+    }
+
+    if (!m_fusionEnabled) {
+      return;
     }
 
     for (auto& sys : m_systems) {
-      sys->postUpdate(delta);
+      GlobalSystem *global = dynamic_cast<GlobalSystem *>(sys.system.get());
+
+      if (global != nullptr && global->isFusable() && sys.declared) {
+        sys.global = global;
+      }
+    }
+
+    std::size_t leader = 0;
+
+    for (std::size_t i = 0; i < m_systems.size(); ++i) {
+      SystemData& sys = m_systems[i];
+
+      if (sys.global == nullptr) {
+        continue;
+      }
+
+      bool fusable = i > 0 && m_systems[i - 1].global != nullptr && m_systems[i - 1].needed == sys.needed;
+
+      /*
+       * the entities are updated block by block by all the systems of the
+       * group, so a system can not join a group where a system accesses a
+       * component type that it writes (or writes a component type that it
+       * accesses)
+       */
+      for (std::size_t k = leader; fusable && k < i; ++k) {
+        fusable = !conflicts(m_systems[k], sys);
+      }
+
+      if (fusable) {
+        SystemData& first = m_systems[leader];
+
+        if (first.fused.empty()) {
+          first.fused.push_back(first.global);
+        }
+
+        first.fused.push_back(sys.global);
+        sys.follower = true;
+
+        /*
+         * the update of a follower is made by the first system of the group,
+         * so the systems that depend on the follower must wait for the group
+         */
+        first.successors.push_back(i);
+        sys.predecessors++;
+
+        // and the group must wait for the systems the follower depends on
+        for (std::size_t k = 0; k < leader; ++k) {
+          std::vector<std::size_t>& successors = m_systems[k].successors;
+
+          if (std::find(successors.begin(), successors.end(), i) != successors.end()
+              && std::find(successors.begin(), successors.end(), leader) == successors.end()) {
+            successors.push_back(leader);
+            first.predecessors++;
+          }
+        }
+      } else {
+        leader = i;
+      }
+    }
+  }
+
+  void Manager::runSystems(void (System::*phase)(float), float delta, bool record) {
+    /*
+     * when recording, the tick is advanced after the update of a system, so
+     * that the modifications made by the system itself are not seen as new
+     * at its next update, but the following ones are
+     */
+    if (!m_threadPool) {
+      for (auto& sys : m_systems) {
+        runSystem(sys, phase, delta, record);
+      }
+
+      return;
+    }
+
+    std::size_t count = m_systems.size();
+    std::unique_ptr<std::atomic<std::size_t>[]> remaining(new std::atomic<std::size_t>[count]);
+
+    for (std::size_t i = 0; i < count; ++i) {
+      remaining[i] = m_systems[i].predecessors;
     }
+
+    ThreadPool *pool = m_threadPool.get();
+    TaskGroup group;
+
+    // the structural changes are recorded in the command buffer until the end of the phase
+    m_concurrentUpdate = true;
+
+    std::function<void(std::size_t)> run = [&](std::size_t i) {
+      runSystem(m_systems[i], phase, delta, record);
+
+      for (std::size_t next : m_systems[i].successors) {
+        if (--remaining[next] == 0) {
+          pool->submit(group, [&run, next]() { run(next); });
+        }
+      }
+    };
+
+    for (std::size_t i = 0; i < count; ++i) {
+      if (m_systems[i].predecessors == 0) {
+        pool->submit(group, [&run, i]() { run(i); });
+      }
+    }
+
+    pool->wait(group);
+    m_concurrentUpdate = false;
   }
 
+  void Manager::runSystem(SystemData& sys, void (System::*phase)(float), float delta, bool record) {
+    if (phase != &System::update || sys.global == nullptr) {
+      (sys.system.get()->*phase)(delta);
+    } else if (!sys.fused.empty()) {
+      sys.global->updateFused(delta, sys.fused);
+    } else if (!sys.follower) {
+      (sys.system.get()->*phase)(delta);
+    }
+
+    // a follower has been updated with the first system of its group
+
+    if (record) {
+      sys.system->m_lastRunTick = m_tick++;
+    }
+  }
 
   void Manager::registerHandler(EventType type, EventHandler handler) {
+    registerHandlerAt(Registry::getEventRegistry().registerType(type), handler);
+  }
+
+  void Manager::registerHandlerAt(std::size_t index, EventHandler handler) {
     assert(handler);
-    auto it = m_handlers.find(type);
+    assert(!m_concurrentUpdate);
+
+    if (index == INVALID_TYPE_INDEX) {
+      return;
+    }
+
+    if (m_dispatchDepth > 0) {
+      m_pendingHandlers.push_back(std::make_pair(index, handler));
+      return;
+    }
+
+    getEventData(index)->handlers.push_back(handler);
+  }
+
+  Manager::EventData *Manager::getEventData(std::size_t index) {
+    if (index == INVALID_TYPE_INDEX) {
+      return nullptr;
+    }
+
+    if (index >= m_events.size()) {
+      m_events.resize(index + 1);
+    }
 
-    if (it == m_handlers.end()) {
-      bool inserted;
-      std::tie(it, inserted) = m_handlers.insert(std::make_pair(type, std::vector<EventHandler>()));
-      assert(inserted);
+    std::unique_ptr<EventData>& data = m_events[index];
+
+    if (!data) {
+      data.reset(new EventData(Registry::getEventRegistry().getType(index)));
     }
 
-    it->second.push_back(handler);
+    return data.get();
   }
 
   void Manager::triggerEvent(es::Entity origin, EventType type, Event *event) {
-    auto it = m_handlers.find(type);
+    assert(!m_concurrentUpdate);
+
+    if (type == INVALID_EVENT) {
+      return;
+    }
+
+    EventData *data = findEventData(Registry::getEventRegistry().getIndex(type));
+
+    if (data == nullptr) {
+      return;
+    }
+
+    if (data->list) {
+      data->list->dispatchEvent(origin, event);
+    }
+
+    dispatchEvent(origin, type, event, data->handlers);
+  }
+
+  void Manager::dispatchEvent(Entity origin, EventType type, Event *event, std::vector<EventHandler>& handlers) {
+    // the handlers and the dispatch state are not protected against the systems updated concurrently
+    assert(!m_concurrentUpdate);
+
+    if (handlers.empty()) {
+      return;
+    }
+
+    /*
+     * the handlers are not moved during the dispatch: the handlers that die
+     * are cleared and removed at the end of the outermost dispatch, and the
+     * handlers that are registered during the dispatch are added at the
+     * same time
+     */
+    m_dispatchDepth++;
+
+    for (std::size_t i = 0; i < handlers.size(); ++i) {
+      if (handlers[i] && handlers[i](origin, type, event) == EventStatus::DIE) {
+        handlers[i] = nullptr;
+        m_handlersDirty = true;
+      }
+    }
+
+    m_dispatchDepth--;
+
+    if (m_dispatchDepth == 0 && (m_handlersDirty || !m_pendingHandlers.empty())) {
+      flushHandlers();
+    }
+  }
+
+  void Manager::flushHandlers() {
+    if (m_handlersDirty) {
+      for (auto& data : m_events) {
+        if (!data) {
+          continue;
+        }
+
+        std::vector<EventHandler>& handlers = data->handlers;
+        handlers.erase(std::remove_if(handlers.begin(), handlers.end(), [](const EventHandler& handler) {
+          return !handler;
+        }), handlers.end());
+      }
+
+      m_handlersDirty = false;
+    }
+
+    for (auto& item : m_pendingHandlers) {
+      getEventData(item.first)->handlers.push_back(std::move(item.second));
+    }
+
+    m_pendingHandlers.clear();
+  }
+
+  Manager::QueueTable::QueueTable(std::size_t n)
+  : queues(new std::atomic<EventQueue *>[n]), size(n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      queues[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  EventQueue *Manager::findEventQueue(std::size_t index) const {
+    const QueueTable *table = m_queueTable.load(std::memory_order_acquire);
+
+    if (table == nullptr || index >= table->size) {
+      return nullptr;
+    }
+
+    return table->queues[index].load(std::memory_order_acquire);
+  }
+
+  void Manager::addEventQueue(std::size_t index, EventQueue *queue) {
+    // called with m_queuesMutex
+    if (index >= m_queues.size()) {
+      m_queues.resize(index + 1);
+    }
+
+    m_queues[index].reset(queue);
 
-    if (it == m_handlers.end()) {
+    QueueTable *table = m_queueTable.load(std::memory_order_relaxed);
+
+    if (table != nullptr && index < table->size) {
+      table->queues[index].store(queue, std::memory_order_release);
       return;
     }
 
-    std::vector<EventHandler> kept;
+    /*
+     * the table is replaced by a bigger copy, the previous tables are kept
+     * because they may still be read by other threads
+     */
+    std::size_t size = table == nullptr ? 16 : 2 * table->size;
+
+    while (size <= index) {
+      size *= 2;
+    }
+
+    QueueTable *bigger = new QueueTable(size);
+
+    for (std::size_t i = 0; i < m_queues.size(); ++i) {
+      bigger->queues[i].store(m_queues[i].get(), std::memory_order_relaxed);
+    }
+
+    m_queueTables.emplace_back(bigger);
+    m_queueTable.store(bigger, std::memory_order_release);
+  }
+
+  void Manager::dispatchQueuedEvents() {
+    {
+      std::lock_guard<std::mutex> lock(m_queuesMutex);
+      m_dispatched.clear();
 
-    for (auto handler : it->second) {
-      if (handler(origin, type, event) == EventStatus::KEEP) {
-        kept.push_back(handler);
+      for (std::size_t index = 0; index < m_queues.size(); ++index) {
+        EventQueue *queue = m_queues[index].get();
+
+        if (queue != nullptr && queue->swap() > 0) {
+          m_dispatched.push_back(std::make_pair(index, queue));
+        }
       }
     }
 
-    std::swap(it->second, kept);
+    // the handlers are cleaned once, after all the events are dispatched
+    m_dispatchDepth++;
+
+    for (auto& item : m_dispatched) {
+      EventData *data = findEventData(item.first);
+
+      if (data == nullptr) {
+        continue;
+      }
+
+      EventQueue *queue = item.second;
+
+      if (data->list) {
+        data->list->dispatchQueue(*queue);
+      }
+
+      for (std::size_t i = 0; i < queue->getSize() && !data->handlers.empty(); ++i) {
+        dispatchEvent(queue->getOriginAt(i), data->type, queue->getEventAt(i), data->handlers);
+      }
+    }
+
+    m_dispatchDepth--;
+
+    if (m_dispatchDepth == 0 && (m_handlersDirty || !m_pendingHandlers.empty())) {
+      flushHandlers();
+    }
   }
 
 }
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/Memory.h>
+
+#include <cstdint>
+#include <new>
+
+namespace es {
+
+  /*
+   * the address returned by operator new is kept just before the aligned
+   * block, so that it can be released
+   */
+
+  void *allocateAligned(std::size_t size) {
+    void *raw = ::operator new(size + sizeof(void *) + CACHE_LINE_SIZE - 1);
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void *);
+    address = (address + CACHE_LINE_SIZE - 1) & ~static_cast<std::uintptr_t>(CACHE_LINE_SIZE - 1);
+
+    void **block = reinterpret_cast<void **>(address);
+    block[-1] = raw;
+    return block;
+  }
+
+  void deallocateAligned(void *ptr) {
+    if (ptr == nullptr) {
+      return;
+    }
+
+    ::operator delete(static_cast<void **>(ptr)[-1]);
+  }
+
+}
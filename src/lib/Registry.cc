@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/Registry.h>
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+
+#include <es/Component.h>
+
+namespace es {
+
+  static std::size_t hashType(Type type) {
+    // the types may be small integers, so their bits are mixed
+    return static_cast<std::size_t>((type * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+  }
+
+  Registry::Table::Table(std::size_t size)
+  : slots(new Slot[size]), mask(size - 1) {
+    assert((size & mask) == 0);
+
+    for (std::size_t i = 0; i < size; ++i) {
+      slots[i].type.store(INVALID_TYPE, std::memory_order_relaxed);
+      slots[i].index.store(INVALID_TYPE_INDEX, std::memory_order_relaxed);
+    }
+  }
+
+  std::size_t Registry::Table::find(Type type) const {
+    for (std::size_t i = hashType(type) & mask;; i = (i + 1) & mask) {
+      Type current = slots[i].type.load(std::memory_order_acquire);
+
+      if (current == type) {
+        return slots[i].index.load(std::memory_order_relaxed);
+      }
+
+      if (current == INVALID_TYPE) {
+        return INVALID_TYPE_INDEX;
+      }
+    }
+  }
+
+  void Registry::Table::insert(Type type, std::size_t index) {
+    for (std::size_t i = hashType(type) & mask;; i = (i + 1) & mask) {
+      if (slots[i].type.load(std::memory_order_relaxed) == INVALID_TYPE) {
+        // the index is published with the type
+        slots[i].index.store(index, std::memory_order_relaxed);
+        slots[i].type.store(type, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  Registry::Registry(std::size_t capacity)
+  : m_capacity(capacity), m_table(nullptr) {
+    m_tables.emplace_back(new Table(16));
+    m_table.store(m_tables.back().get(), std::memory_order_release);
+  }
+
+  std::size_t Registry::registerType(Type type, const char *name) {
+    if (type == INVALID_TYPE) {
+      return INVALID_TYPE_INDEX;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Table *table = m_table.load(std::memory_order_relaxed);
+    std::size_t index = table->find(type);
+
+    if (index != INVALID_TYPE_INDEX) {
+      if (name == nullptr) {
+        return index;
+      }
+
+      if (m_names[index].empty()) {
+        m_names[index] = name;
+        return index;
+      }
+
+      if (m_names[index] != name) {
+        // two different names with the same hash
+        return INVALID_TYPE_INDEX;
+      }
+
+      return index;
+    }
+
+    if (m_types.size() == m_capacity) {
+      return INVALID_TYPE_INDEX;
+    }
+
+    // keep the table at most half full, so that the probes stay short
+    if (2 * (m_types.size() + 1) > table->mask + 1) {
+      Table *bigger = new Table(2 * (table->mask + 1));
+
+      for (std::size_t i = 0; i < m_types.size(); ++i) {
+        bigger->insert(m_types[i], i);
+      }
+
+      m_tables.emplace_back(bigger);
+      m_table.store(bigger, std::memory_order_release);
+      table = bigger;
+    }
+
+    index = m_types.size();
+    m_types.push_back(type);
+    m_names.push_back(name == nullptr ? std::string() : std::string(name));
+    table->insert(type, index);
+    return index;
+  }
+
+  std::size_t Registry::getIndex(Type type) const {
+    if (type == INVALID_TYPE) {
+      return INVALID_TYPE_INDEX;
+    }
+
+    return m_table.load(std::memory_order_acquire)->find(type);
+  }
+
+  Type Registry::getType(std::size_t index) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return index < m_types.size() ? m_types[index] : INVALID_TYPE;
+  }
+
+  std::size_t Registry::getSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_types.size();
+  }
+
+  Registry& Registry::getComponentRegistry() {
+    static Registry registry(MAX_COMPONENT_TYPES);
+    return registry;
+  }
+
+  Registry& Registry::getEventRegistry() {
+    // the event types are not limited
+    static Registry registry(std::numeric_limits<std::size_t>::max());
+    return registry;
+  }
+
+}
@@ -0,0 +1,508 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/SpatialSystem.h>
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include <es/Manager.h>
+
+namespace es {
+
+  bool SpatialSystem::addEntity(Entity e) {
+    if (m_boundsType == INVALID_COMPONENT || findMember(e) != INVALID_NODE) {
+      return false;
+    }
+
+    Bounds bounds;
+
+    if (!computeBounds(getManager()->getStore(m_boundsType), e, bounds)) {
+      return false;
+    }
+
+    std::size_t leaf = allocateNode();
+    Node& node = m_nodes[leaf];
+    node.bounds = bounds.getInflated(m_margin);
+    node.tight = bounds;
+    node.entity = e;
+    insertLeaf(leaf);
+
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_positions.size()) {
+      m_positions.resize(index + 1, INVALID_NODE);
+    }
+
+    m_positions[index] = m_members.size();
+    m_members.push_back({ e, leaf });
+    return true;
+  }
+
+  bool SpatialSystem::removeEntity(Entity e) {
+    std::size_t position = findMember(e);
+
+    if (position == INVALID_NODE) {
+      return false;
+    }
+
+    std::size_t leaf = m_members[position].node;
+    removeLeaf(leaf);
+    freeNode(leaf);
+
+    std::size_t last = m_members.size() - 1;
+    m_positions[getEntityIndex(e)] = INVALID_NODE;
+
+    if (position != last) {
+      m_members[position] = m_members[last];
+      m_positions[getEntityIndex(m_members[position].entity)] = position;
+    }
+
+    m_members.pop_back();
+    return true;
+  }
+
+  void SpatialSystem::update(float delta) {
+    refit();
+
+    // the members may change during the update
+    m_snapshot.clear();
+
+    for (const Member& member : m_members) {
+      m_snapshot.push_back(member.entity);
+    }
+
+    for (Entity e : m_snapshot) {
+      if (findMember(e) != INVALID_NODE) {
+        updateEntity(delta, e);
+      }
+    }
+  }
+
+  void SpatialSystem::updateEntity(float delta, Entity e) {
+    // nothing by default
+  }
+
+  void SpatialSystem::bindBounds(ComponentType ct, BoundsFunction bounds) {
+    assert(ct != INVALID_COMPONENT);
+    assert(bounds);
+    m_bounds = std::move(bounds);
+
+    if (m_changes != nullptr) {
+      getManager()->getStore(m_boundsType)->destroyChangeList(m_changes);
+      m_changes = nullptr;
+    }
+
+    m_boundsType = ct;
+  }
+
+  void SpatialSystem::refit() {
+    if (m_boundsType == INVALID_COMPONENT) {
+      return;
+    }
+
+    Store *store = getManager()->getStore(m_boundsType);
+
+    if (store == nullptr) {
+      return;
+    }
+
+    if (m_changes == nullptr) {
+      // the previous modifications are unknown, check all the members once
+      m_changes = store->createChangeList();
+
+      for (const Member& member : m_members) {
+        refitMember(store, member);
+      }
+
+      return;
+    }
+
+    for (std::size_t i = 0; i < m_changes->getSize(); ++i) {
+      uint32_t index = m_changes->getIndexAt(i);
+
+      if (index < m_positions.size() && m_positions[index] != INVALID_NODE) {
+        refitMember(store, m_members[m_positions[index]]);
+      }
+    }
+
+    m_changes->clear();
+  }
+
+  void SpatialSystem::refitMember(Store *store, const Member& member) {
+    Bounds bounds;
+
+    if (!computeBounds(store, member.entity, bounds)) {
+      return;
+    }
+
+    Node& node = m_nodes[member.node];
+    node.tight = bounds;
+
+    if (node.bounds.contains(bounds)) {
+      return;
+    }
+
+    // the entity has left its enlarged bounds, reinsert it
+    removeLeaf(member.node);
+    m_nodes[member.node].bounds = bounds.getInflated(m_margin);
+    insertLeaf(member.node);
+  }
+
+  bool SpatialSystem::getBounds(Entity e, Bounds& bounds) const {
+    std::size_t position = findMember(e);
+
+    if (position == INVALID_NODE) {
+      return false;
+    }
+
+    bounds = m_nodes[m_members[position].node].tight;
+    return true;
+  }
+
+  void SpatialSystem::queryBounds(const Bounds& bounds, std::vector<Entity>& result) const {
+    if (m_root == INVALID_NODE) {
+      return;
+    }
+
+    std::vector<std::size_t> stack;
+    stack.push_back(m_root);
+
+    while (!stack.empty()) {
+      const Node& node = m_nodes[stack.back()];
+      stack.pop_back();
+
+      if (!node.bounds.overlaps(bounds)) {
+        continue;
+      }
+
+      if (node.isLeaf()) {
+        if (node.tight.overlaps(bounds)) {
+          result.push_back(node.entity);
+        }
+      } else {
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+      }
+    }
+  }
+
+  void SpatialSystem::queryRadius(float x, float y, float radius, std::vector<Entity>& result) const {
+    if (m_root == INVALID_NODE) {
+      return;
+    }
+
+    float radiusSquared = radius * radius;
+
+    std::vector<std::size_t> stack;
+    stack.push_back(m_root);
+
+    while (!stack.empty()) {
+      const Node& node = m_nodes[stack.back()];
+      stack.pop_back();
+
+      if (node.bounds.getDistanceSquared(x, y) > radiusSquared) {
+        continue;
+      }
+
+      if (node.isLeaf()) {
+        if (node.tight.getDistanceSquared(x, y) <= radiusSquared) {
+          result.push_back(node.entity);
+        }
+      } else {
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+      }
+    }
+  }
+
+  void SpatialSystem::queryNearest(float x, float y, std::size_t k, std::vector<Entity>& result) const {
+    if (m_root == INVALID_NODE || k == 0) {
+      return;
+    }
+
+    /*
+     * best-first search: the distance of an internal node is a lower bound
+     * of the distances of its leaves, and the distance of a leaf is the
+     * exact distance of its entity. So, when a leaf is at the top of the
+     * heap, it is the nearest of the remaining entities.
+     */
+    typedef std::pair<float, std::size_t> Entry;
+    std::vector<Entry> heap;
+    std::greater<Entry> compare;
+
+    heap.push_back(std::make_pair(m_nodes[m_root].bounds.getDistanceSquared(x, y), m_root));
+
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), compare);
+      std::size_t index = heap.back().second;
+      heap.pop_back();
+
+      const Node& node = m_nodes[index];
+
+      if (node.isLeaf()) {
+        result.push_back(node.entity);
+
+        if (--k == 0) {
+          return;
+        }
+
+        continue;
+      }
+
+      for (std::size_t child : { node.left, node.right }) {
+        const Node& other = m_nodes[child];
+        const Bounds& bounds = other.isLeaf() ? other.tight : other.bounds;
+        heap.push_back(std::make_pair(bounds.getDistanceSquared(x, y), child));
+        std::push_heap(heap.begin(), heap.end(), compare);
+      }
+    }
+  }
+
+  std::size_t SpatialSystem::findMember(Entity e) const {
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_positions.size()) {
+      return INVALID_NODE;
+    }
+
+    std::size_t position = m_positions[index];
+
+    if (position == INVALID_NODE || m_members[position].entity != e) {
+      return INVALID_NODE;
+    }
+
+    return position;
+  }
+
+  bool SpatialSystem::computeBounds(Store *store, Entity e, Bounds& bounds) const {
+    const Component *c = store != nullptr ? store->read(e) : nullptr;
+
+    if (c == nullptr) {
+      return false;
+    }
+
+    m_bounds(c, bounds);
+    return true;
+  }
+
+  std::size_t SpatialSystem::allocateNode() {
+    std::size_t index;
+
+    if (m_freeNodes.empty()) {
+      index = m_nodes.size();
+      m_nodes.push_back(Node());
+    } else {
+      index = m_freeNodes.back();
+      m_freeNodes.pop_back();
+    }
+
+    Node& node = m_nodes[index];
+    node.parent = INVALID_NODE;
+    node.left = INVALID_NODE;
+    node.right = INVALID_NODE;
+    node.height = 0;
+    node.entity = INVALID_ENTITY;
+    return index;
+  }
+
+  void SpatialSystem::freeNode(std::size_t node) {
+    m_freeNodes.push_back(node);
+  }
+
+  void SpatialSystem::insertLeaf(std::size_t leaf) {
+    if (m_root == INVALID_NODE) {
+      m_root = leaf;
+      m_nodes[leaf].parent = INVALID_NODE;
+      return;
+    }
+
+    /*
+     * find the best sibling, with the perimeter as the cost: the cost of a
+     * new parent at this node, or the cost of going down in a child, plus
+     * the cost of enlarging the ancestors
+     */
+    const Bounds bounds = m_nodes[leaf].bounds;
+    std::size_t index = m_root;
+
+    while (!m_nodes[index].isLeaf()) {
+      const Node& node = m_nodes[index];
+
+      float perimeter = node.bounds.getPerimeter();
+      float combined = Bounds::merge(node.bounds, bounds).getPerimeter();
+
+      float cost = 2.0f * combined;
+      float inheritance = 2.0f * (combined - perimeter);
+
+      float costs[2];
+      std::size_t children[2] = { node.left, node.right };
+
+      for (int i = 0; i < 2; ++i) {
+        const Node& child = m_nodes[children[i]];
+        costs[i] = Bounds::merge(child.bounds, bounds).getPerimeter() + inheritance;
+
+        if (!child.isLeaf()) {
+          costs[i] -= child.bounds.getPerimeter();
+        }
+      }
+
+      if (cost < costs[0] && cost < costs[1]) {
+        break;
+      }
+
+      index = costs[0] < costs[1] ? children[0] : children[1];
+    }
+
+    std::size_t sibling = index;
+
+    // create a new parent for the leaf and its sibling
+    std::size_t oldParent = m_nodes[sibling].parent;
+    std::size_t newParent = allocateNode();
+
+    Node& parent = m_nodes[newParent];
+    parent.parent = oldParent;
+    parent.bounds = Bounds::merge(bounds, m_nodes[sibling].bounds);
+    parent.height = m_nodes[sibling].height + 1;
+    parent.left = sibling;
+    parent.right = leaf;
+
+    if (oldParent != INVALID_NODE) {
+      if (m_nodes[oldParent].left == sibling) {
+        m_nodes[oldParent].left = newParent;
+      } else {
+        m_nodes[oldParent].right = newParent;
+      }
+    } else {
+      m_root = newParent;
+    }
+
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    fixUpwards(m_nodes[leaf].parent);
+  }
+
+  void SpatialSystem::removeLeaf(std::size_t leaf) {
+    if (leaf == m_root) {
+      m_root = INVALID_NODE;
+      return;
+    }
+
+    std::size_t parent = m_nodes[leaf].parent;
+    std::size_t grandParent = m_nodes[parent].parent;
+    std::size_t sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+    // replace the parent with the sibling
+    if (grandParent != INVALID_NODE) {
+      if (m_nodes[grandParent].left == parent) {
+        m_nodes[grandParent].left = sibling;
+      } else {
+        m_nodes[grandParent].right = sibling;
+      }
+
+      m_nodes[sibling].parent = grandParent;
+      freeNode(parent);
+      fixUpwards(grandParent);
+    } else {
+      m_root = sibling;
+      m_nodes[sibling].parent = INVALID_NODE;
+      freeNode(parent);
+    }
+
+    m_nodes[leaf].parent = INVALID_NODE;
+  }
+
+  void SpatialSystem::fixUpwards(std::size_t index) {
+    while (index != INVALID_NODE) {
+      index = balance(index);
+
+      Node& node = m_nodes[index];
+      const Node& left = m_nodes[node.left];
+      const Node& right = m_nodes[node.right];
+      node.height = 1 + std::max(left.height, right.height);
+      node.bounds = Bounds::merge(left.bounds, right.bounds);
+
+      index = node.parent;
+    }
+  }
+
+  std::size_t SpatialSystem::balance(std::size_t a) {
+    Node& nodeA = m_nodes[a];
+
+    if (nodeA.isLeaf() || nodeA.height < 2) {
+      return a;
+    }
+
+    std::size_t b = nodeA.left;
+    std::size_t c = nodeA.right;
+
+    int difference = m_nodes[c].height - m_nodes[b].height;
+
+    if (difference < -1) {
+      std::swap(b, c);
+    } else if (difference <= 1) {
+      return a;
+    }
+
+    /*
+     * c is the higher child of a, it takes the place of a, and a takes the
+     * place of the higher child of c
+     */
+    Node& nodeC = m_nodes[c];
+    std::size_t f = nodeC.left;
+    std::size_t g = nodeC.right;
+    bool cIsRight = (nodeA.right == c);
+
+    nodeC.parent = nodeA.parent;
+    nodeA.parent = c;
+
+    if (nodeC.parent != INVALID_NODE) {
+      if (m_nodes[nodeC.parent].left == a) {
+        m_nodes[nodeC.parent].left = c;
+      } else {
+        m_nodes[nodeC.parent].right = c;
+      }
+    } else {
+      m_root = c;
+    }
+
+    if (m_nodes[f].height < m_nodes[g].height) {
+      std::swap(f, g);
+    }
+
+    // f is the higher grandchild, it stays under c, g goes under a
+    nodeC.left = a;
+    nodeC.right = f;
+
+    if (cIsRight) {
+      nodeA.right = g;
+    } else {
+      nodeA.left = g;
+    }
+
+    m_nodes[g].parent = a;
+
+    nodeA.bounds = Bounds::merge(m_nodes[b].bounds, m_nodes[g].bounds);
+    nodeA.height = 1 + std::max(m_nodes[b].height, m_nodes[g].height);
+    nodeC.bounds = Bounds::merge(nodeA.bounds, m_nodes[f].bounds);
+    nodeC.height = 1 + std::max(nodeA.height, m_nodes[f].height);
+
+    return c;
+  }
+
+  const std::size_t SpatialSystem::INVALID_NODE;
+
+}
@@ -15,36 +15,220 @@
  */
 #include <es/Store.h>
 
+#include <algorithm>
+#include <utility>
+
 namespace es {
 
+  void ChangeList::clear() {
+    std::size_t size = getSize();
+
+    for (std::size_t position = 0; position < size; ++position) {
+      m_flags[m_indices[position]].store(false, std::memory_order_relaxed);
+    }
+
+    m_size.store(0, std::memory_order_relaxed);
+  }
+
+  void ChangeList::reserve(std::size_t capacity) {
+    if (capacity <= m_capacity) {
+      return;
+    }
+
+    // the capacity grows geometrically, as the entity indices come one by one
+    capacity = std::max(capacity, 2 * m_capacity);
+
+    std::unique_ptr<std::atomic<bool>[]> flags(new std::atomic<bool>[capacity]);
+    std::unique_ptr<uint32_t[]> indices(new uint32_t[capacity]);
+
+    for (std::size_t index = 0; index < capacity; ++index) {
+      bool flag = index < m_capacity && m_flags[index].load(std::memory_order_relaxed);
+      flags[index].store(flag, std::memory_order_relaxed);
+    }
+
+    std::copy(m_indices.get(), m_indices.get() + getSize(), indices.get());
+
+    m_flags = std::move(flags);
+    m_indices = std::move(indices);
+    m_capacity = capacity;
+  }
+
+  Store::~Store() {
+    for (ChangeList *list : m_changeLists) {
+      delete list;
+    }
+
+    if (m_pool != nullptr) {
+      for (Component *c : m_components) {
+        m_pool->destroy(c);
+      }
+
+      delete m_pool;
+    }
+  }
+
   bool Store::has(Entity e) {
-    auto it = m_store.find(e);
-    return it != m_store.end();
+    return getSlot(e) != INVALID_SLOT;
   }
 
   Component *Store::get(Entity e) {
-    auto it = m_store.find(e);
-    return (it == m_store.end() ? nullptr : it->second);
+    std::size_t slot = getSlot(e);
+    return (slot == INVALID_SLOT ? nullptr : m_components[slot]);
+  }
+
+  Component *Store::write(Entity e) {
+    std::size_t slot = getSlot(e);
+
+    if (slot == INVALID_SLOT) {
+      return nullptr;
+    }
+
+    m_ticks[slot] = getCurrentTick();
+    recordChange(e);
+    return m_components[slot];
+  }
+
+  void Store::resolve(const Entity *entities, std::size_t size, Component **components, bool mark) {
+    uint64_t tick = getCurrentTick();
+
+    for (std::size_t i = 0; i < size; ++i) {
+      std::size_t slot = getSlot(entities[i]);
+
+      if (slot == INVALID_SLOT) {
+        components[i] = nullptr;
+        continue;
+      }
+
+      if (mark) {
+        m_ticks[slot] = tick;
+        recordChange(entities[i]);
+      }
+
+      components[i] = m_components[slot];
+    }
+  }
+
+  const Component *Store::read(Entity e) const {
+    std::size_t slot = getSlot(e);
+    return (slot == INVALID_SLOT ? nullptr : m_components[slot]);
+  }
+
+  bool Store::mark(Entity e) {
+    std::size_t slot = getSlot(e);
+
+    if (slot == INVALID_SLOT) {
+      return false;
+    }
+
+    m_ticks[slot] = getCurrentTick();
+    recordChange(e);
+    return true;
+  }
+
+  ChangeList *Store::createChangeList() {
+    ChangeList *list = new ChangeList;
+    list->reserve(m_sparse.size());
+    m_changeLists.push_back(list);
+    return list;
+  }
+
+  void Store::destroyChangeList(ChangeList *list) {
+    auto it = std::find(m_changeLists.begin(), m_changeLists.end(), list);
+    assert(it != m_changeLists.end());
+    m_changeLists.erase(it);
+    delete list;
+  }
+
+  uint64_t Store::getChangeTick(Entity e) const {
+    std::size_t slot = getSlot(e);
+    return (slot == INVALID_SLOT ? 0 : m_ticks[slot]);
   }
 
   bool Store::add(Entity e, Component *c) {
-    auto ret = m_store.insert(std::make_pair(e, c));
-    return ret.second;
+    if (e == INVALID_ENTITY || getSlot(e) != INVALID_SLOT) {
+      return false;
+    }
+
+    uint32_t index = getEntityIndex(e);
+
+    if (index >= m_sparse.size()) {
+      m_sparse.resize(index + 1, INVALID_SLOT);
+
+      for (ChangeList *list : m_changeLists) {
+        list->reserve(m_sparse.size());
+      }
+    }
+
+    std::size_t slot = m_sparse[index];
+
+    if (slot < m_entities.size() && m_entities[slot] != e) {
+      // a stale entity with the same index is still here, replace it
+      if (m_pool != nullptr) {
+        m_pool->destroy(m_components[slot]);
+      }
+
+      m_entities[slot] = e;
+      m_components[slot] = c;
+      m_ticks[slot] = getCurrentTick();
+      recordChange(e);
+      return true;
+    }
+
+    m_sparse[index] = m_entities.size();
+    m_entities.push_back(e);
+    m_components.push_back(c);
+    m_ticks.push_back(getCurrentTick());
+    recordChange(e);
+    return true;
   }
 
   bool Store::remove(Entity e) {
-    auto count = m_store.erase(e);
-    return count > 0;
+    std::size_t slot = getSlot(e);
+
+    if (slot == INVALID_SLOT) {
+      return false;
+    }
+
+    /*
+     * swap with the last element so that the packed arrays stay contiguous
+     */
+    std::size_t last = m_entities.size() - 1;
+
+    if (slot != last) {
+      Entity moved = m_entities[last];
+      m_entities[slot] = moved;
+      m_components[slot] = m_components[last];
+      m_ticks[slot] = m_ticks[last];
+      m_sparse[getEntityIndex(moved)] = slot;
+    }
+
+    m_entities.pop_back();
+    m_components.pop_back();
+    m_ticks.pop_back();
+    m_sparse[getEntityIndex(e)] = INVALID_SLOT;
+    return true;
   }
 
-  std::set<Entity> Store::getEntities() const {
-    std::set<Entity> ret;
+  bool Store::destroy(Entity e) {
+    if (m_pool == nullptr) {
+      return false;
+    }
+
+    Component *c = get(e);
 
-    for (auto elt : m_store) {
-      ret.insert(elt.first);
+    if (c == nullptr) {
+      return false;
     }
 
-    return ret;
+    remove(e);
+    m_pool->destroy(c);
+    return true;
   }
 
+  std::set<Entity> Store::getEntities() const {
+    return std::set<Entity>(m_entities.begin(), m_entities.end());
+  }
+
+  const std::size_t Store::INVALID_SLOT;
+
 }
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/ThreadPool.h>
+
+#include <cassert>
+
+namespace es {
+
+  /*
+   * the pool of the worker running on the current thread and its index, set
+   * once when the worker starts
+   */
+  static thread_local const ThreadPool *currentPool = nullptr;
+  static thread_local std::size_t currentIndex = 0;
+
+  ThreadPool::ThreadPool(unsigned count)
+  : m_queued(0), m_next(0), m_stop(false) {
+    /*
+     * the last queue is for the threads that are not workers
+     */
+    for (unsigned i = 0; i <= count; ++i) {
+      m_queues.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+      m_threads.push_back(std::thread(&ThreadPool::work, this, i));
+    }
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+
+    m_cond.notify_all();
+
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+
+    assert(m_queued.load() == 0);
+  }
+
+  void ThreadPool::submit(TaskGroup& group, Task task) {
+    group.m_pending++;
+
+    Job job;
+    job.task = std::move(task);
+    job.group = &group;
+
+    Queue& queue = *m_queues[getCurrentQueue()];
+    m_queued++;
+
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.jobs.push_back(std::move(job));
+    }
+
+    {
+      // take the lock so that a sleeping thread can not miss the job
+      std::lock_guard<std::mutex> lock(m_mutex);
+    }
+
+    m_cond.notify_one();
+  }
+
+  void ThreadPool::wait(TaskGroup& group) {
+    std::size_t index = getCurrentQueue();
+
+    while (!group.isDone()) {
+      Job job;
+
+      if (take(index, job)) {
+        execute(job);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this, &group]() { return group.isDone() || m_queued.load() > 0; });
+    }
+  }
+
+  void ThreadPool::parallelFor(std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& fn) {
+    if (begin >= end) {
+      return;
+    }
+
+    if (grain == 0) {
+      grain = 1;
+    }
+
+    TaskGroup group;
+    split(group, begin, end, grain, fn);
+    wait(group);
+  }
+
+  void ThreadPool::split(TaskGroup& group, std::size_t begin, std::size_t end, std::size_t grain, const std::function<void(std::size_t, std::size_t)>& fn) {
+    /*
+     * give the upper half to the pool (it may be stolen) and continue with
+     * the lower half
+     */
+    while (end - begin > grain) {
+      std::size_t middle = begin + (end - begin) / 2;
+      submit(group, [this, &group, middle, end, grain, &fn]() {
+        split(group, middle, end, grain, fn);
+      });
+      end = middle;
+    }
+
+    fn(begin, end);
+  }
+
+  void ThreadPool::work(std::size_t index) {
+    currentPool = this;
+    currentIndex = index;
+
+    for (;;) {
+      Job job;
+
+      if (take(index, job)) {
+        execute(job);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this]() { return m_stop || m_queued.load() > 0; });
+
+      if (m_stop && m_queued.load() == 0) {
+        return;
+      }
+    }
+  }
+
+  std::size_t ThreadPool::getCurrentQueue() const {
+    if (currentPool == this) {
+      return currentIndex;
+    }
+
+    return m_threads.size();
+  }
+
+  bool ThreadPool::take(std::size_t index, Job& job) {
+    if (m_queued.load() == 0) {
+      return false;
+    }
+
+    /*
+     * first, the own queue, from the back
+     */
+    {
+      Queue& queue = *m_queues[index];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+
+      if (!queue.jobs.empty()) {
+        job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+        m_queued--;
+        return true;
+      }
+    }
+
+    /*
+     * then, steal from the other queues, from the front
+     */
+    std::size_t count = m_queues.size();
+    std::size_t start = m_next++;
+
+    for (std::size_t i = 0; i < count; ++i) {
+      Queue& queue = *m_queues[(start + i) % count];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+
+      if (!queue.jobs.empty()) {
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        m_queued--;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void ThreadPool::execute(Job& job) {
+    TaskGroup *group = job.group;
+    job.task();
+
+    if (--group->m_pending == 0) {
+      /*
+       * take the lock so that a waiting thread can not miss the notification
+       * between its check and its wait
+       */
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_cond.notify_all();
+    }
+  }
+
+}
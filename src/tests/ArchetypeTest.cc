@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <set>
+#include <vector>
+
+#include <es/Archetype.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 1;
+};
+
+struct Velocity : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 2;
+};
+
+/*
+ * the entities of the archetypes that contain some component types, with a
+ * check of the columns against the stores
+ */
+static std::set<es::Entity> collect(es::Manager& manager, const std::set<es::ComponentType>& needed) {
+  std::set<es::Entity> entities;
+
+  for (es::Archetype *archetype : manager.getArchetypes(needed)) {
+    ES_CHECK(archetype->getSize() > 0);
+    ES_CHECK(archetype->getColumnCount() == archetype->getSignature().count());
+    std::size_t position = archetype->getColumnIndex<Position>();
+
+    for (std::size_t row = 0; row < archetype->getSize(); ++row) {
+      es::Entity e = archetype->getEntityAt(row);
+      ES_CHECK(archetype->getEntities()[row] == e);
+
+      if (position != es::INVALID_TYPE_INDEX) {
+        ES_CHECK(archetype->getComponentAt<Position>(position, row) == manager.getComponent<Position>(e));
+        ES_CHECK(archetype->getColumn(position)[row] == manager.getComponent<Position>(e));
+      }
+
+      ES_CHECK(entities.insert(e).second);
+    }
+  }
+
+  return entities;
+}
+
+static void testArchetypes() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Position>();
+  manager.createPooledStoreFor<Velocity>();
+
+  // the existing entities are put in their archetype
+  es::Entity a = manager.createEntity();
+  manager.emplaceComponent<Position>(a);
+  manager.enableArchetypes();
+  ES_CHECK(manager.hasArchetypes());
+
+  es::Entity b = manager.createEntity();
+  manager.emplaceComponent<Position>(b);
+  manager.emplaceComponent<Velocity>(b);
+
+  es::Entity c = manager.createEntity();
+  manager.emplaceComponent<Velocity>(c);
+
+  ES_CHECK((collect(manager, { Position::type }) == std::set<es::Entity>{ a, b }));
+  ES_CHECK((collect(manager, { Velocity::type }) == std::set<es::Entity>{ b, c }));
+  ES_CHECK((collect(manager, { Position::type, Velocity::type }) == std::set<es::Entity>{ b }));
+  ES_CHECK(manager.getArchetypes({ Position::type, Velocity::type }).size() == 1);
+
+  // the row moves to the archetype of the new signature
+  manager.emplaceComponent<Velocity>(a);
+  ES_CHECK((collect(manager, { Position::type, Velocity::type }) == std::set<es::Entity>{ a, b }));
+
+  manager.destroyComponent<Position>(b);
+  ES_CHECK((collect(manager, { Position::type, Velocity::type }) == std::set<es::Entity>{ a }));
+  ES_CHECK((collect(manager, { Velocity::type }) == std::set<es::Entity>{ a, b, c }));
+
+  // the empty archetypes are not returned
+  ES_CHECK(manager.destroyEntity(a));
+  ES_CHECK(manager.getArchetypes({ Position::type }).empty());
+  ES_CHECK((collect(manager, { Velocity::type }) == std::set<es::Entity>{ b, c }));
+}
+
+int main() {
+  testArchetypes();
+  return 0;
+}
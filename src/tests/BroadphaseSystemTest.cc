@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <es/BroadphaseSystem.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Disc : es::Component {
+  float x;
+  float y;
+  float r;
+
+  Disc(float cx, float cy, float radius)
+  : x(cx), y(cy), r(radius) {
+  }
+
+  static const es::ComponentType type = 1;
+};
+
+static es::Bounds getBounds(const Disc& disc) {
+  return { disc.x - disc.r, disc.y - disc.r, disc.x + disc.r, disc.y + disc.r };
+}
+
+class Contacts : public es::BroadphaseSystem {
+public:
+  Contacts(es::Manager *manager)
+  : es::BroadphaseSystem(1, { Disc::type }, manager), m_calls(0) {
+    bindBounds<Disc>([](const Disc& disc, es::Bounds& bounds) {
+      bounds = getBounds(disc);
+    });
+  }
+
+  virtual void updatePair(float delta, es::Entity first, es::Entity second) override {
+    m_calls++;
+  }
+
+  std::size_t getCalls() const {
+    return m_calls;
+  }
+
+  void resetCalls() {
+    m_calls = 0;
+  }
+
+private:
+  std::size_t m_calls;
+};
+
+typedef std::pair<es::Entity, es::Entity> Pair;
+
+static void checkPairs(es::Manager& manager, Contacts& contacts, const std::vector<es::Entity>& entities) {
+  std::vector<Pair> result;
+
+  for (const es::ContactPair& pair : contacts.getPairs()) {
+    result.push_back(std::minmax(pair.first, pair.second));
+  }
+
+  std::sort(result.begin(), result.end());
+
+  // each pair appears once
+  ES_CHECK(std::adjacent_find(result.begin(), result.end()) == result.end());
+  ES_CHECK(contacts.getCalls() == result.size());
+  contacts.resetCalls();
+
+  // the pairs are compared with a brute force check
+  std::vector<Pair> expected;
+
+  for (std::size_t i = 0; i < entities.size(); ++i) {
+    es::Bounds bounds = getBounds(*manager.readComponent<Disc>(entities[i]));
+
+    for (std::size_t j = i + 1; j < entities.size(); ++j) {
+      if (bounds.overlaps(getBounds(*manager.readComponent<Disc>(entities[j])))) {
+        expected.push_back(std::minmax(entities[i], entities[j]));
+      }
+    }
+  }
+
+  std::sort(expected.begin(), expected.end());
+  ES_CHECK(result == expected);
+}
+
+int main() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Disc>();
+
+  auto contacts = std::make_shared<Contacts>(&manager);
+  manager.addSystem(contacts);
+  manager.initSystems();
+
+  std::mt19937 engine(5);
+  std::uniform_real_distribution<float> coordinate(0.0f, 100.0f);
+  std::uniform_real_distribution<float> radius(0.0f, 2.0f);
+
+  std::vector<es::Entity> entities;
+
+  for (int i = 0; i < 1500; ++i) {
+    es::Entity e = manager.createEntity();
+    // some large discs, that overlap many others
+    manager.emplaceComponent<Disc>(e, coordinate(engine), coordinate(engine), i % 50 == 0 ? 20.0f : radius(engine));
+    manager.subscribeEntityToSystems(e);
+    entities.push_back(e);
+  }
+
+  manager.updateSystems(0.0f);
+  checkPairs(manager, *contacts, entities);
+
+  // the modified entities are read again at the next update
+  for (int i = 0; i < 4; ++i) {
+    for (es::Entity e : entities) {
+      if (engine() % 2 == 0) {
+        Disc *disc = manager.writeComponent<Disc>(e);
+        disc->x += radius(engine) * 3.0f - 3.0f;
+        disc->y += radius(engine) - 1.0f;
+      }
+    }
+
+    manager.updateSystems(0.0f);
+    checkPairs(manager, *contacts, entities);
+  }
+
+  // remove a third of the entities and add new ones
+  std::vector<es::Entity> kept;
+
+  for (std::size_t i = 0; i < entities.size(); ++i) {
+    if (i % 3 == 0) {
+      manager.destroyEntity(entities[i]);
+    } else {
+      kept.push_back(entities[i]);
+    }
+  }
+
+  manager.synchronize();
+  entities = kept;
+  ES_CHECK(contacts->getEntityCount() == entities.size());
+
+  for (int i = 0; i < 100; ++i) {
+    es::Entity e = manager.createEntity();
+    manager.emplaceComponent<Disc>(e, coordinate(engine), coordinate(engine), radius(engine));
+    manager.subscribeEntityToSystems(e);
+    entities.push_back(e);
+  }
+
+  manager.updateSystems(0.0f);
+  checkPairs(manager, *contacts, entities);
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <vector>
+
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  int x = 0;
+  static const es::ComponentType type = 1;
+};
+
+struct Velocity : es::Component {
+  int dx = 1;
+  static const es::ComponentType type = 2;
+};
+
+static void testLookups() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Position>();
+
+  es::Entity e = manager.createEntity();
+  manager.emplaceComponent<Position>(e);
+  es::Store *store = manager.getStore(Position::type);
+  es::ChangeList *changes = store->createChangeList();
+
+  // get and read are pure lookups, write marks the component
+  ES_CHECK(store->get(e) != nullptr);
+  ES_CHECK(manager.readComponent<Position>(e) != nullptr);
+  ES_CHECK(changes->getSize() == 0);
+
+  ES_CHECK(manager.writeComponent<Position>(e) != nullptr);
+  ES_CHECK(manager.writeComponent<Position>(e) != nullptr);
+  ES_CHECK(changes->getSize() == 1);
+
+  changes->clear();
+  ES_CHECK(manager.getComponent<Position>(e) != nullptr);
+  ES_CHECK(changes->getSize() == 0);
+}
+
+static void testViews(bool archetypes) {
+  es::Manager manager;
+
+  if (archetypes) {
+    manager.enableArchetypes();
+  }
+
+  manager.createPooledStoreFor<Position>();
+  manager.createPooledStoreFor<Velocity>();
+
+  es::Entity moving = manager.createEntity();
+  manager.emplaceComponent<Position>(moving);
+  manager.emplaceComponent<Velocity>(moving);
+
+  es::Entity still = manager.createEntity();
+  manager.emplaceComponent<Position>(still);
+
+  std::vector<es::Entity> changed;
+
+  manager.registerObserver<Position>(es::ComponentEvent::CHANGED, [&](es::ComponentType ct, es::ComponentEvent event, const std::vector<es::Entity>& entities) {
+    changed.insert(changed.end(), entities.begin(), entities.end());
+    return es::EventStatus::KEEP;
+  });
+
+  manager.synchronize();
+
+  es::ChangeList *positions = manager.getStore(Position::type)->createChangeList();
+  es::ChangeList *velocities = manager.getStore(Velocity::type)->createChangeList();
+  uint64_t tick = manager.getStore(Position::type)->getChangeTick(still);
+
+  int calls = 0;
+
+  manager.each<Position, const Velocity>([&](es::Entity e, Position& position, const Velocity& velocity) {
+    ES_CHECK(e == moving);
+    position.x += velocity.dx;
+    calls++;
+  });
+
+  ES_CHECK(calls == 1);
+
+  // only the written components of the visited entities are marked
+  ES_CHECK(positions->getSize() == 1);
+  ES_CHECK(positions->getIndexAt(0) == es::getEntityIndex(moving));
+  ES_CHECK(velocities->getSize() == 0);
+  ES_CHECK(manager.getStore(Position::type)->getChangeTick(still) == tick);
+
+  // as with Manager::writeComponent, the observers are notified
+  manager.synchronize();
+  ES_CHECK(changed.size() == 1);
+  ES_CHECK(changed[0] == moving);
+}
+
+int main() {
+  testLookups();
+  testViews(false);
+  testViews(true);
+  return 0;
+}
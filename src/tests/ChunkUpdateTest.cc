@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <memory>
+#include <vector>
+
+#include <es/ColumnStore.h>
+#include <es/GlobalSystem.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  float value = 0.0f;
+  static const es::ComponentType type = 1;
+};
+
+struct Velocity : es::Component {
+  typedef es::ColumnStore<float> Columns;
+  static const es::ComponentType type = 2;
+};
+
+class Mover : public es::GlobalSystem {
+public:
+  Mover(es::Manager *manager)
+  : es::GlobalSystem(1, { Position::type, Velocity::type }, manager), m_count(0) {
+    enableChunkUpdate(8);
+    declareAccess({ Velocity::type }, { Position::type });
+  }
+
+  virtual void updateChunk(float delta, const es::Chunk& chunk) override {
+    es::Manager *manager = getManager();
+    Velocity::Columns *velocities = manager->getColumnStore<Velocity>();
+
+    std::size_t positions = getChunkColumn(Position::type);
+    std::size_t rows = getChunkColumn(Velocity::type);
+
+    ES_CHECK(chunk.getColumnCount() == 2);
+    ES_CHECK(chunk.getSize() > 0 && chunk.getSize() <= 8);
+    m_sizes.push_back(chunk.getSize());
+
+    for (std::size_t i = 0; i < chunk.getSize(); ++i) {
+      es::Entity e = chunk.getEntityAt(i);
+      ES_CHECK(chunk.getEntities()[i] == e);
+
+      // a component of a store is resolved, a component of a column store is given by its row
+      Position *position = chunk.getComponentAt<Position>(positions, i);
+      ES_CHECK(position == manager->getComponent<Position>(e));
+      ES_CHECK(chunk.getRowAt(positions, i) == es::ColumnStoreBase::INVALID_ROW);
+      ES_CHECK(chunk.getComponentAt<Velocity>(rows, i) == nullptr);
+
+      std::size_t row = chunk.getRowAt(rows, i);
+      ES_CHECK(row == velocities->find(e));
+
+      position->value += velocities->getColumn<0>()[row] * delta;
+      m_count++;
+    }
+  }
+
+  std::size_t getCount() const {
+    return m_count;
+  }
+
+  const std::vector<std::size_t>& getSizes() const {
+    return m_sizes;
+  }
+
+private:
+  std::size_t m_count;
+  std::vector<std::size_t> m_sizes;
+};
+
+static void testChunks() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Position>();
+  manager.createColumnStoreFor<Velocity>();
+
+  auto mover = std::make_shared<Mover>(&manager);
+  manager.addSystem(mover);
+  manager.initSystems();
+
+  std::vector<es::Entity> entities;
+
+  for (int i = 0; i < 30; ++i) {
+    es::Entity e = manager.createEntity();
+    manager.emplaceComponent<Position>(e);
+    ES_CHECK(manager.addColumnComponent<Velocity>(e, static_cast<float>(i)));
+    manager.subscribeEntityToSystems(e);
+    entities.push_back(e);
+  }
+
+  // an entity without velocity is not updated
+  es::Entity still = manager.createEntity();
+  manager.emplaceComponent<Position>(still);
+  manager.subscribeEntityToSystems(still);
+
+  manager.updateSystems(2.0f);
+
+  ES_CHECK(mover->getCount() == 30);
+  ES_CHECK((mover->getSizes() == std::vector<std::size_t>{ 8, 8, 8, 6 }));
+
+  for (std::size_t i = 0; i < entities.size(); ++i) {
+    ES_CHECK(manager.getComponent<Position>(entities[i])->value == 2.0f * i);
+  }
+
+  ES_CHECK(manager.getComponent<Position>(still)->value == 0.0f);
+}
+
+int main() {
+  testChunks();
+  return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <cstdint>
+
+#include <es/ColumnStore.h>
+
+#include "Test.h"
+
+typedef es::ColumnStore<float, int32_t, double> Columns;
+
+static bool isAligned(const void *pointer) {
+  return reinterpret_cast<uintptr_t>(pointer) % es::ColumnStoreBase::ALIGNMENT == 0;
+}
+
+static void checkColumns(Columns& store) {
+  ES_CHECK(store.getCapacity() % es::ColumnStoreBase::PADDING == 0);
+  ES_CHECK(store.getCapacity() >= store.getSize());
+  ES_CHECK(isAligned(store.getColumn<0>()));
+  ES_CHECK(isAligned(store.getColumn<1>()));
+  ES_CHECK(isAligned(store.getColumn<2>()));
+
+  // the fields of a row belong to the entity of the row
+  for (std::size_t row = 0; row < store.getSize(); ++row) {
+    uint32_t index = es::getEntityIndex(store.getEntityAt(row));
+    ES_CHECK(store.getColumn<0>()[row] == static_cast<float>(index));
+    ES_CHECK(store.getColumn<1>()[row] == static_cast<int32_t>(index) * 2);
+    ES_CHECK(store.getColumn<2>()[row] == static_cast<double>(index) / 2);
+    ES_CHECK(store.find(store.getEntityAt(row)) == row);
+  }
+}
+
+static void testInsertRemove() {
+  Columns store;
+  ES_CHECK(store.getSize() == 0);
+
+  // several growths of the columns
+  for (uint32_t i = 1; i <= 100; ++i) {
+    ES_CHECK(store.add(es::makeEntity(i, 0), static_cast<float>(i), static_cast<int32_t>(i) * 2, static_cast<double>(i) / 2));
+  }
+
+  ES_CHECK(!store.add(es::makeEntity(1, 0), 0.0f, 0, 0.0));
+  ES_CHECK(store.getSize() == 100);
+  ES_CHECK(store.getCapacity() >= 100);
+  checkColumns(store);
+
+  // the last entity takes the row of the removed entity
+  std::size_t row = store.find(es::makeEntity(10, 0));
+  ES_CHECK(store.remove(es::makeEntity(10, 0)));
+  ES_CHECK(!store.remove(es::makeEntity(10, 0)));
+  ES_CHECK(!store.has(es::makeEntity(10, 0)));
+  ES_CHECK(store.getEntityAt(row) == es::makeEntity(100, 0));
+  ES_CHECK(store.getSize() == 99);
+  checkColumns(store);
+
+  for (uint32_t i = 1; i <= 100; i += 3) {
+    store.remove(es::makeEntity(i, 0));
+  }
+
+  checkColumns(store);
+
+  ES_CHECK(*store.getField<1>(es::makeEntity(99, 0)) == 198);
+  ES_CHECK(store.getField<1>(es::makeEntity(10, 0)) == nullptr);
+
+  // a handle with another generation is not in the store
+  ES_CHECK(!store.has(es::makeEntity(99, 1)));
+  ES_CHECK(store.find(es::makeEntity(99, 1)) == es::ColumnStoreBase::INVALID_ROW);
+}
+
+int main() {
+  testInsertRemove();
+  return 0;
+}
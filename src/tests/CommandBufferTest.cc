@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <memory>
+
+#include <es/GlobalSystem.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Counter : es::Component {
+  int value;
+
+  Counter(int initial = 0)
+  : value(initial) {
+  }
+
+  static const es::ComponentType type = 1;
+};
+
+struct Tag : es::Component {
+  static const es::ComponentType type = 2;
+};
+
+struct Tracked : es::Component {
+  static int alive;
+
+  Tracked() {
+    alive++;
+  }
+
+  ~Tracked() {
+    alive--;
+  }
+
+  static const es::ComponentType type = 3;
+};
+
+int Tracked::alive = 0;
+
+/*
+ * spawns an entity (deferred) when a counter reaches 1, and destroys the
+ * entity when its counter reaches 3
+ */
+class Spawner : public es::GlobalSystem {
+public:
+  Spawner(es::Manager *manager)
+  : es::GlobalSystem(1, { Counter::type }, manager), m_updates(0) {
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    m_updates++;
+
+    es::Manager *manager = getManager();
+    Counter *counter = manager->getComponent<Counter>(e);
+    counter->value++;
+
+    if (counter->value == 1) {
+      es::CommandBuffer& commands = manager->getCommandBuffer();
+      es::Entity spawned = commands.createEntity();
+      commands.addComponent(spawned, new Counter(100));
+      commands.subscribeEntity(spawned);
+    }
+
+    if (counter->value == 3) {
+      manager->destroyEntity(e);
+    }
+  }
+
+  int getUpdates() const {
+    return m_updates;
+  }
+
+private:
+  int m_updates;
+};
+
+static void testDeferredCreation() {
+  es::Manager manager;
+  manager.createStoreFor<Counter>();
+
+  auto spawner = std::make_shared<Spawner>(&manager);
+  manager.addSystem(spawner);
+  manager.initSystems();
+
+  Counter counter;
+  es::Entity e = manager.createEntity();
+  manager.addComponent(e, &counter);
+  manager.subscribeEntityToSystems(e);
+
+  // the spawned entity is created at the end of the update
+  manager.updateSystems(0.0f);
+  ES_CHECK(spawner->getUpdates() == 1);
+  ES_CHECK(manager.getEntities().size() == 2);
+
+  manager.updateSystems(0.0f);
+  ES_CHECK(spawner->getUpdates() == 3);
+
+  manager.updateSystems(0.0f);
+  ES_CHECK(spawner->getUpdates() == 5);
+  ES_CHECK(!manager.isAlive(e));
+  ES_CHECK(manager.getEntities().size() == 1);
+
+  for (es::Entity spawned : manager.getEntities()) {
+    delete manager.extractComponent<Counter>(spawned);
+  }
+}
+
+static void testDeferredRemoval() {
+  es::Manager manager;
+  manager.createStoreFor<Tag>();
+  manager.createPooledStoreFor<Counter>();
+
+  es::CommandBuffer& commands = manager.getCommandBuffer();
+
+  // a store that does not own its components can not destroy them later
+  Tag tag;
+  es::Entity e = manager.createEntity();
+  manager.addComponent(e, &tag);
+  ES_CHECK(!commands.removeComponent<Tag>(e));
+
+  es::Entity f = manager.createEntity();
+  manager.emplaceComponent<Counter>(f, 1);
+  ES_CHECK(commands.removeComponent<Counter>(f));
+  ES_CHECK(manager.getComponent<Counter>(f) != nullptr);
+
+  manager.synchronize();
+  ES_CHECK(manager.getComponent<Counter>(f) == nullptr);
+
+  // a destruction is applied once, even if the entity is subscribed again
+  commands.destroyEntity(e);
+  commands.subscribeEntity(e);
+  manager.synchronize();
+  ES_CHECK(!manager.isAlive(e));
+}
+
+static void testDroppedAdditions() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Counter>();
+  manager.createStoreFor<Tracked>();
+
+  es::CommandBuffer& commands = manager.getCommandBuffer();
+  es::ComponentPool<Counter> *pool = static_cast<es::ComponentPool<Counter> *>(manager.getStore(Counter::type)->getPool());
+
+  // the second addition comes after the destruction, it is dropped
+  es::Entity e = manager.createEntity();
+  Counter *first = pool->create(1);
+  Counter *second = pool->create(2);
+  commands.addComponent(e, first);
+  commands.destroyEntity(e);
+  commands.addComponent(e, second);
+  manager.synchronize();
+  ES_CHECK(!manager.isAlive(e));
+
+  // both components are back in the pool, their slots are reused
+  Counter *reused1 = pool->create();
+  Counter *reused2 = pool->create();
+  ES_CHECK((reused1 == first && reused2 == second) || (reused1 == second && reused2 == first));
+  pool->destroy(reused1);
+  pool->destroy(reused2);
+
+  // an addition that fails is dropped too
+  es::Entity f = manager.createEntity();
+  manager.emplaceComponent<Counter>(f, 3);
+  Counter *third = pool->create(4);
+  commands.addComponent(f, third);
+  manager.synchronize();
+  ES_CHECK(manager.getComponent<Counter>(f)->value == 3);
+  ES_CHECK(pool->create() == third);
+
+  // a dropped component of a store that does not own its components is deleted
+  es::Entity g = manager.createEntity();
+  Tracked *tracked = new Tracked;
+  commands.addComponent(g, tracked);
+  commands.destroyEntity(g);
+  commands.addComponent(g, new Tracked);
+  manager.synchronize();
+  ES_CHECK(Tracked::alive == 1);
+  delete tracked;
+}
+
+int main() {
+  testDeferredCreation();
+  testDeferredRemoval();
+  testDroppedAdditions();
+  return 0;
+}
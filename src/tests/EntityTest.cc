@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 1;
+};
+
+static void testRecycling() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Position>();
+
+  es::Entity old = manager.createEntity();
+  ES_CHECK(old != INVALID_ENTITY);
+  ES_CHECK(manager.isAlive(old));
+  manager.emplaceComponent<Position>(old)->value = 1;
+
+  ES_CHECK(manager.destroyEntity(old));
+  ES_CHECK(!manager.isAlive(old));
+  ES_CHECK(!manager.destroyEntity(old));
+
+  // the index is recycled with a new generation
+  es::Entity e = manager.createEntity();
+  ES_CHECK(es::getEntityIndex(e) == es::getEntityIndex(old));
+  ES_CHECK(es::getEntityGeneration(e) == es::getEntityGeneration(old) + 1);
+  ES_CHECK(manager.isAlive(e));
+  ES_CHECK(!manager.isAlive(old));
+
+  // the old handle does not reach the components of the new entity
+  manager.emplaceComponent<Position>(e)->value = 2;
+  ES_CHECK(manager.getComponent<Position>(old) == nullptr);
+  ES_CHECK(manager.emplaceComponent<Position>(old) == nullptr);
+  ES_CHECK(!manager.destroyEntity(old));
+  ES_CHECK(manager.getComponent<Position>(e)->value == 2);
+
+  // a new index is only used when there is no free index
+  es::Entity other = manager.createEntity();
+  ES_CHECK(es::getEntityIndex(other) != es::getEntityIndex(e));
+  ES_CHECK(es::getEntityGeneration(other) == 0);
+}
+
+int main() {
+  testRecycling();
+  return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <thread>
+#include <vector>
+
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Damage : es::Event {
+  int amount;
+  static const es::EventType type = 1;
+};
+
+struct Death : es::Event {
+  static const es::EventType type = 2;
+};
+
+static void testQueuedEvents() {
+  es::Manager manager;
+
+  int count = 0;
+  long total = 0;
+  int deaths = 0;
+
+  manager.registerHandler(Damage::type, [&](es::Entity origin, es::EventType type, es::Event *event) {
+    ES_CHECK(type == Damage::type);
+    Damage *damage = static_cast<Damage *>(event);
+    count++;
+    total += damage->amount;
+
+    // queued during the dispatch: dispatched at the next synchronization point
+    if (damage->amount == 0) {
+      manager.queueEvent(origin, Death());
+    }
+
+    return es::EventStatus::KEEP;
+  });
+
+  manager.registerHandler(Death::type, [&](es::Entity origin, es::EventType type, es::Event *event) {
+    deaths++;
+    return es::EventStatus::KEEP;
+  });
+
+  // the events can be queued from several threads
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([&manager, t]() {
+      for (int i = 0; i < 1000; ++i) {
+        Damage damage;
+        damage.amount = i;
+        manager.queueEvent(es::makeEntity(t + 1, 0), damage);
+      }
+    }));
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  ES_CHECK(count == 0);
+
+  manager.synchronize();
+  ES_CHECK(count == 4000);
+  ES_CHECK(total == 4L * 999L * 1000L / 2);
+  ES_CHECK(deaths == 0);
+
+  manager.synchronize();
+  ES_CHECK(count == 4000);
+  ES_CHECK(deaths == 4);
+
+  // the queue is empty afterwards
+  manager.synchronize();
+  ES_CHECK(count == 4000);
+  ES_CHECK(deaths == 4);
+}
+
+static void testTriggeredEvents() {
+  es::Manager manager;
+
+  int calls = 0;
+
+  manager.registerHandler(Damage::type, [&calls](es::Entity origin, es::EventType type, es::Event *event) {
+    calls++;
+    return es::EventStatus::DIE;
+  });
+
+  manager.registerHandler(Damage::type, [&calls](es::Entity origin, es::EventType type, es::Event *event) {
+    calls += 10;
+    return es::EventStatus::KEEP;
+  });
+
+  Damage damage;
+  damage.amount = 1;
+
+  // the handler that dies is removed after the dispatch
+  manager.triggerEvent(es::makeEntity(1, 0), &damage);
+  ES_CHECK(calls == 11);
+  manager.triggerEvent(es::makeEntity(1, 0), Damage::type, &damage);
+  ES_CHECK(calls == 21);
+
+  // no handler
+  Death death;
+  manager.triggerEvent(es::makeEntity(1, 0), &death);
+  manager.queueEvent(es::makeEntity(1, 0), death);
+  manager.synchronize();
+  ES_CHECK(calls == 21);
+}
+
+static int stateless = 0;
+
+class Health {
+public:
+  Health()
+  : m_value(100) {
+  }
+
+  es::EventStatus onDamage(es::Entity origin, const Damage& damage) {
+    m_value -= damage.amount;
+    return es::EventStatus::KEEP;
+  }
+
+  int getValue() const {
+    return m_value;
+  }
+
+private:
+  int m_value;
+};
+
+static void testTypedHandlers() {
+  es::Manager manager;
+  Health health;
+  std::vector<int> order;
+
+  manager.registerHandler<Damage>([](es::Entity origin, const Damage& damage) {
+    stateless += damage.amount;
+    return es::EventStatus::DIE;
+  });
+
+  manager.registerHandler<Damage>([&order](es::Entity origin, const Damage& damage) {
+    order.push_back(1);
+    return es::EventStatus::KEEP;
+  });
+
+  manager.registerHandler<Damage, Health, &Health::onDamage>(&health);
+
+  // the typed handlers are called before the generic handlers
+  manager.registerHandler(Damage::type, [&order](es::Entity origin, es::EventType type, es::Event *event) {
+    order.push_back(2);
+    return es::EventStatus::KEEP;
+  });
+
+  Damage damage;
+  damage.amount = 5;
+  manager.triggerEvent(es::makeEntity(1, 0), &damage);
+
+  ES_CHECK(stateless == 5);
+  ES_CHECK(health.getValue() == 95);
+  ES_CHECK((order == std::vector<int>{ 1, 2 }));
+
+  // the first handler died, the others receive the queued events, the typed handlers first for the whole batch
+  manager.queueEvent(es::makeEntity(1, 0), damage);
+  manager.queueEvent(es::makeEntity(2, 0), damage);
+  manager.synchronize();
+
+  ES_CHECK(stateless == 5);
+  ES_CHECK(health.getValue() == 85);
+  ES_CHECK((order == std::vector<int>{ 1, 2, 1, 1, 2, 2 }));
+}
+
+int main() {
+  testQueuedEvents();
+  testTriggeredEvents();
+  testTypedHandlers();
+  return 0;
+}
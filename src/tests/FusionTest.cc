@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <memory>
+#include <vector>
+
+#include <es/GlobalSystem.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 1;
+};
+
+struct Velocity : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 2;
+};
+
+struct Age : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 3;
+};
+
+class Mover : public es::GlobalSystem {
+public:
+  Mover(es::Manager *manager)
+  : es::GlobalSystem(1, { Position::type, Velocity::type, Age::type }, manager) {
+    enableFusion();
+    declareAccess({ Velocity::type }, { Position::type });
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    es::Manager *manager = getManager();
+    manager->writeComponent<Position>(e)->value += manager->readComponent<Velocity>(e)->value;
+  }
+};
+
+class Ager : public es::GlobalSystem {
+public:
+  Ager(es::Manager *manager)
+  : es::GlobalSystem(2, { Position::type, Velocity::type, Age::type }, manager) {
+    enableFusion();
+    enableChunkUpdate(8);
+    declareAccess({ }, { Age::type });
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    getManager()->writeComponent<Age>(e)->value++;
+  }
+};
+
+struct State {
+  int position;
+  int age;
+
+  bool operator==(const State& other) const {
+    return position == other.position && age == other.age;
+  }
+};
+
+/*
+ * two updates with the same entities in both systems, then two updates
+ * after an entity has been removed from each system
+ */
+static std::vector<State> run(bool fusion) {
+  es::Manager manager;
+
+  if (fusion) {
+    manager.enableSystemFusion();
+  }
+
+  manager.createPooledStoreFor<Position>();
+  manager.createPooledStoreFor<Velocity>();
+  manager.createPooledStoreFor<Age>();
+
+  auto mover = std::make_shared<Mover>(&manager);
+  auto ager = std::make_shared<Ager>(&manager);
+  manager.addSystem(mover);
+  manager.addSystem(ager);
+  manager.initSystems();
+
+  std::vector<es::Entity> entities;
+
+  for (int i = 0; i < 100; ++i) {
+    es::Entity e = manager.createEntity();
+    manager.emplaceComponent<Position>(e);
+    manager.emplaceComponent<Velocity>(e)->value = i;
+    manager.emplaceComponent<Age>(e);
+    manager.subscribeEntityToSystems(e);
+    entities.push_back(e);
+  }
+
+  manager.updateSystems(0.0f);
+  manager.updateSystems(0.0f);
+
+  // the first system of the group and a follower do not have the same entities anymore
+  ES_CHECK(mover->removeEntity(entities[20]));
+  ES_CHECK(ager->removeEntity(entities[10]));
+
+  manager.updateSystems(0.0f);
+  manager.updateSystems(0.0f);
+
+  std::vector<State> states;
+
+  for (es::Entity e : entities) {
+    states.push_back(State{ manager.readComponent<Position>(e)->value, manager.readComponent<Age>(e)->value });
+  }
+
+  return states;
+}
+
+static void testFusion() {
+  std::vector<State> fused = run(true);
+  std::vector<State> unfused = run(false);
+
+  ES_CHECK(fused == unfused);
+  ES_CHECK(fused.size() == 100);
+
+  for (std::size_t i = 0; i < fused.size(); ++i) {
+    int value = static_cast<int>(i);
+    ES_CHECK(fused[i].position == (i == 20 ? 2 : 4) * value);
+    ES_CHECK(fused[i].age == (i == 10 ? 2 : 4));
+  }
+}
+
+int main() {
+  testFusion();
+  return 0;
+}
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <es/LocalSystem.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  float x;
+  float y;
+
+  Position(float px, float py)
+  : x(px), y(py) {
+  }
+
+  static const es::ComponentType type = 1;
+};
+
+static const float CELL_SIZE = 10.0f;
+static const int GRID_SIZE = 8;
+
+class Neighbours : public es::LocalSystem {
+public:
+  Neighbours(es::Manager *manager)
+  : es::LocalSystem(1, { Position::type }, manager) {
+    bindPosition<Position>(CELL_SIZE, [](const Position& position, float& x, float& y) {
+      x = position.x;
+      y = position.y;
+    });
+  }
+
+  Neighbours(es::Manager *manager, int width, int height)
+  : es::LocalSystem(1, { Position::type }, manager, width, height) {
+    bindPosition<Position>(CELL_SIZE, [](const Position& position, float& x, float& y) {
+      x = position.x;
+      y = position.y;
+    });
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    m_updated.push_back(e);
+  }
+
+  std::vector<es::Entity>& getUpdated() {
+    return m_updated;
+  }
+
+  std::set<es::Entity> getNeighbours() const {
+    return getEntities();
+  }
+
+private:
+  std::vector<es::Entity> m_updated;
+};
+
+static int getCellCoordinate(float position, bool sparse) {
+  int coordinate = static_cast<int>(std::floor(position / CELL_SIZE));
+
+  if (!sparse) {
+    coordinate = std::min(std::max(coordinate, 0), GRID_SIZE - 1);
+  }
+
+  return coordinate;
+}
+
+static void testMigration(bool sparse) {
+  es::Manager manager;
+  manager.createPooledStoreFor<Position>();
+
+  auto neighbours = sparse ? std::make_shared<Neighbours>(&manager) : std::make_shared<Neighbours>(&manager, GRID_SIZE, GRID_SIZE);
+  manager.addSystem(neighbours);
+  manager.initSystems();
+
+  std::mt19937 engine(42);
+  std::uniform_real_distribution<float> coordinate(-20.0f, 100.0f);
+
+  std::vector<es::Entity> entities;
+
+  for (int i = 0; i < 300; ++i) {
+    es::Entity e = manager.createEntity();
+    manager.emplaceComponent<Position>(e, coordinate(engine), coordinate(engine));
+    manager.subscribeEntityToSystems(e);
+    entities.push_back(e);
+  }
+
+  for (int frame = 0; frame < 200; ++frame) {
+    // a few moves, to an adjacent cell or anywhere, and sometimes many moves
+    int moves = frame % 10 == 0 ? 250 : 5;
+
+    for (int i = 0; i < moves; ++i) {
+      Position *position = manager.writeComponent<Position>(entities[engine() % entities.size()]);
+
+      if (engine() % 2 == 0) {
+        position->x += (static_cast<int>(engine() % 3) - 1) * CELL_SIZE;
+        position->y += (static_cast<int>(engine() % 3) - 1) * CELL_SIZE;
+      } else {
+        position->x = coordinate(engine);
+        position->y = coordinate(engine);
+      }
+    }
+
+    if (frame % 17 == 0) {
+      manager.destroyEntity(entities.back());
+      manager.synchronize();
+      entities.pop_back();
+
+      es::Entity e = manager.createEntity();
+      manager.emplaceComponent<Position>(e, coordinate(engine), coordinate(engine));
+      manager.subscribeEntityToSystems(e);
+      entities.push_back(e);
+    }
+
+    int x = static_cast<int>(engine() % GRID_SIZE);
+    int y = static_cast<int>(engine() % GRID_SIZE);
+    int radius = static_cast<int>(engine() % 3);
+    neighbours->clearFoci();
+    neighbours->addFocus(x, y, radius);
+
+    neighbours->getUpdated().clear();
+    manager.updateSystems(0.0f);
+
+    // each entity of the neighbourhood is updated once
+    const std::vector<es::Entity>& updated = neighbours->getUpdated();
+    std::set<es::Entity> result(updated.begin(), updated.end());
+    ES_CHECK(result.size() == updated.size());
+    ES_CHECK(result == neighbours->getNeighbours());
+
+    std::set<es::Entity> expected;
+
+    for (es::Entity e : entities) {
+      const Position *position = manager.readComponent<Position>(e);
+      int cx = getCellCoordinate(position->x, sparse);
+      int cy = getCellCoordinate(position->y, sparse);
+
+      if (std::abs(cx - x) <= radius && std::abs(cy - y) <= radius) {
+        expected.insert(e);
+      }
+    }
+
+    ES_CHECK(result == expected);
+  }
+}
+
+/*
+ * a system whose entities are put in their cells manually
+ */
+class Cells : public es::LocalSystem {
+public:
+  Cells(es::Manager *manager)
+  : es::LocalSystem(1, { }, manager) {
+  }
+
+  Cells(es::Manager *manager, int width, int height)
+  : es::LocalSystem(1, { }, manager, width, height) {
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    m_updated.push_back(e);
+  }
+
+  std::set<es::Entity> getUpdated() {
+    std::set<es::Entity> updated(m_updated.begin(), m_updated.end());
+    ES_CHECK(updated.size() == m_updated.size());
+    m_updated.clear();
+    return updated;
+  }
+
+private:
+  std::vector<es::Entity> m_updated;
+};
+
+static void testSparseCells() {
+  es::Manager manager;
+  Cells cells(&manager);
+  ES_CHECK(cells.isSparse());
+  ES_CHECK(cells.getCellCount() == 0);
+
+  es::Entity far = es::makeEntity(1, 0);
+  es::Entity negative = es::makeEntity(2, 0);
+  es::Entity origin = es::makeEntity(3, 0);
+  es::Entity other = es::makeEntity(4, 0);
+
+  // the cells are allocated on demand, with unbounded coordinates
+  ES_CHECK(cells.addLocalEntity(far, 1000000, -1000000));
+  ES_CHECK(cells.addLocalEntity(negative, -5, -5));
+  ES_CHECK(cells.addLocalEntity(origin, 0, 0));
+  ES_CHECK(cells.addLocalEntity(other, 0, 0));
+  ES_CHECK(!cells.addLocalEntity(other, 0, 0));
+  ES_CHECK(cells.getCellCount() == 3);
+
+  cells.clearFoci();
+  cells.addFocus(1000000, -1000000, 0);
+  cells.update(0.0f);
+  ES_CHECK((cells.getUpdated() == std::set<es::Entity>{ far }));
+
+  cells.setFocus(-4, -4);
+  cells.update(0.0f);
+  ES_CHECK((cells.getUpdated() == std::set<es::Entity>{ negative }));
+
+  // the empty cells are reclaimed
+  ES_CHECK(!cells.removeLocalEntity(far, 0, 0));
+  ES_CHECK(cells.removeLocalEntity(far, 1000000, -1000000));
+  ES_CHECK(cells.getCellCount() == 2);
+
+  ES_CHECK(cells.addLocalEntity(negative, 1, 1));
+  ES_CHECK(cells.getCellCount() == 2);
+
+  cells.setFocus(0, 0);
+  cells.update(0.0f);
+  ES_CHECK((cells.getUpdated() == std::set<es::Entity>{ negative, origin, other }));
+
+  // a dense grid has all its cells
+  Cells grid(&manager, GRID_SIZE, GRID_SIZE);
+  ES_CHECK(!grid.isSparse());
+  ES_CHECK(grid.getCellCount() == GRID_SIZE * GRID_SIZE);
+}
+
+/*
+ * an entity in each cell of a dense grid, and the entities in the
+ * neighbourhoods of the foci
+ */
+static void testFoci(bool sparse) {
+  es::Manager manager;
+  std::unique_ptr<Cells> cells(sparse ? new Cells(&manager) : new Cells(&manager, GRID_SIZE, GRID_SIZE));
+  std::vector<es::Entity> entities;
+
+  for (int y = 0; y < GRID_SIZE; ++y) {
+    for (int x = 0; x < GRID_SIZE; ++x) {
+      es::Entity e = es::makeEntity(static_cast<uint32_t>(y * GRID_SIZE + x + 1), 0);
+      ES_CHECK(cells->addLocalEntity(e, x, y));
+      entities.push_back(e);
+    }
+  }
+
+  auto neighbourhood = [&entities](int fx, int fy, int radius) {
+    std::set<es::Entity> expected;
+
+    for (int y = 0; y < GRID_SIZE; ++y) {
+      for (int x = 0; x < GRID_SIZE; ++x) {
+        if (std::abs(x - fx) <= radius && std::abs(y - fy) <= radius) {
+          expected.insert(entities[y * GRID_SIZE + x]);
+        }
+      }
+    }
+
+    return expected;
+  };
+
+  // overlapping neighbourhoods: each entity is updated once
+  cells->clearFoci();
+  cells->addFocus(2, 2, 1);
+  cells->addFocus(3, 3, 1);
+  cells->addFocus(2, 2, 0);
+  ES_CHECK(cells->getFocusCount() == 3);
+  cells->update(0.0f);
+
+  std::set<es::Entity> expected = neighbourhood(2, 2, 1);
+  std::set<es::Entity> second = neighbourhood(3, 3, 1);
+  expected.insert(second.begin(), second.end());
+  ES_CHECK(expected.size() == 14);
+  ES_CHECK(cells->getUpdated() == expected);
+
+  // disjoint neighbourhoods, one of them on the border
+  cells->clearFoci();
+  cells->addFocus(0, 0, 2);
+  cells->addFocus(6, 5, 1);
+  cells->update(0.0f);
+
+  expected = neighbourhood(0, 0, 2);
+  second = neighbourhood(6, 5, 1);
+  expected.insert(second.begin(), second.end());
+  ES_CHECK(expected.size() == 18);
+  ES_CHECK(cells->getUpdated() == expected);
+
+  // a neighbourhood that contains another one
+  cells->clearFoci();
+  cells->addFocus(4, 4, 3);
+  cells->addFocus(4, 4, 1);
+  cells->update(0.0f);
+  ES_CHECK(cells->getUpdated() == neighbourhood(4, 4, 3));
+
+  // no focus, no update
+  cells->clearFoci();
+  ES_CHECK(cells->getFocusCount() == 0);
+  cells->update(0.0f);
+  ES_CHECK(cells->getUpdated().empty());
+}
+
+/*
+ * checks that the cells updated at the same time are at least 3 cells
+ * apart, with an entity in each cell
+ */
+class ParallelCells : public es::LocalSystem {
+public:
+  ParallelCells(es::Manager *manager, int size)
+  : es::LocalSystem(1, { }, manager, size, size), m_size(size), m_active(new std::atomic<int>[size * size]), m_running(0), m_maxRunning(0) {
+    enableParallelUpdate(2);
+
+    for (int i = 0; i < size * size; ++i) {
+      m_active[i] = 0;
+    }
+  }
+
+  void place(es::Entity e, int x, int y) {
+    ES_CHECK(addLocalEntity(e, x, y));
+    m_cells[e] = y * m_size + x;
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    int cell = m_cells.at(e);
+    int x = cell % m_size;
+    int y = cell / m_size;
+
+    int running = ++m_running;
+    int max = m_maxRunning.load();
+
+    while (running > max && !m_maxRunning.compare_exchange_weak(max, running)) {
+    }
+
+    m_active[cell]++;
+
+    for (int dy = -2; dy <= 2; ++dy) {
+      for (int dx = -2; dx <= 2; ++dx) {
+        int nx = x + dx;
+        int ny = y + dy;
+
+        if ((dx != 0 || dy != 0) && nx >= 0 && nx < m_size && ny >= 0 && ny < m_size) {
+          ES_CHECK(m_active[ny * m_size + nx].load() == 0);
+        }
+      }
+    }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    m_active[cell]--;
+    --m_running;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_updated.push_back(e);
+  }
+
+  std::vector<es::Entity>& getUpdated() {
+    return m_updated;
+  }
+
+  int getMaxRunning() const {
+    return m_maxRunning.load();
+  }
+
+private:
+  int m_size;
+  std::map<es::Entity, int> m_cells;
+  std::unique_ptr<std::atomic<int>[]> m_active;
+  std::atomic<int> m_running;
+  std::atomic<int> m_maxRunning;
+  std::mutex m_mutex;
+  std::vector<es::Entity> m_updated;
+};
+
+static void testParallelCells() {
+  static const int SIZE = 16;
+
+  es::Manager manager;
+  manager.setThreadCount(4);
+
+  ParallelCells cells(&manager, SIZE);
+  ES_CHECK(cells.isParallel());
+
+  std::set<es::Entity> entities;
+
+  for (int y = 0; y < SIZE; ++y) {
+    for (int x = 0; x < SIZE; ++x) {
+      es::Entity e = es::makeEntity(static_cast<uint32_t>(y * SIZE + x + 1), 0);
+      cells.place(e, x, y);
+      entities.insert(e);
+    }
+  }
+
+  cells.clearFoci();
+  cells.addFocus(SIZE / 2, SIZE / 2, SIZE);
+
+  for (int i = 0; i < 3; ++i) {
+    cells.getUpdated().clear();
+    cells.update(0.0f);
+
+    // each entity is updated once
+    const std::vector<es::Entity>& updated = cells.getUpdated();
+    ES_CHECK(updated.size() == entities.size());
+    ES_CHECK(std::set<es::Entity>(updated.begin(), updated.end()) == entities);
+  }
+
+  ES_CHECK(cells.getMaxRunning() >= 2);
+}
+
+int main() {
+  testMigration(false);
+  testMigration(true);
+  testSparseCells();
+  testFoci(false);
+  testFoci(true);
+  testParallelCells();
+  return 0;
+}
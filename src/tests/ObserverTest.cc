@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <vector>
+
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Health : es::Component {
+  static const es::ComponentType type = 1;
+};
+
+static void testBatches() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Health>();
+
+  std::vector<es::Entity> added;
+  std::vector<es::Entity> removed;
+  std::vector<es::Entity> changed;
+  int addedCalls = 0;
+
+  manager.registerObserver<Health>(es::ComponentEvent::ADDED, [&](es::ComponentType ct, es::ComponentEvent event, const std::vector<es::Entity>& entities) {
+    ES_CHECK(ct == Health::type);
+    ES_CHECK(event == es::ComponentEvent::ADDED);
+    addedCalls++;
+    added.insert(added.end(), entities.begin(), entities.end());
+    return es::EventStatus::KEEP;
+  });
+
+  manager.registerObserver<Health>(es::ComponentEvent::REMOVED, [&](es::ComponentType ct, es::ComponentEvent event, const std::vector<es::Entity>& entities) {
+    removed = entities;
+    return es::EventStatus::DIE;
+  });
+
+  manager.registerObserver<Health>(es::ComponentEvent::CHANGED, [&](es::ComponentType ct, es::ComponentEvent event, const std::vector<es::Entity>& entities) {
+    changed = entities;
+    return es::EventStatus::KEEP;
+  });
+
+  es::Entity e1 = manager.createEntity();
+  es::Entity e2 = manager.createEntity();
+  manager.emplaceComponent<Health>(e2);
+  manager.emplaceComponent<Health>(e1);
+
+  // the observers are notified at the synchronization point
+  ES_CHECK(added.empty());
+
+  manager.markChanged<Health>(e1);
+  manager.markChanged<Health>(e1);
+
+  // one batch, sorted, without duplicates
+  manager.synchronize();
+  ES_CHECK(addedCalls == 1);
+  ES_CHECK(added.size() == 2);
+  ES_CHECK(added[0] < added[1]);
+  ES_CHECK(changed.size() == 1);
+
+  manager.synchronize();
+  ES_CHECK(addedCalls == 1);
+
+  manager.destroyComponent<Health>(e1);
+  manager.destroyEntity(e2);
+  manager.synchronize();
+  ES_CHECK(removed.size() == 2);
+
+  // the removed observer died, and an entity added then destroyed is not seen
+  es::Entity e3 = manager.createEntity();
+  manager.emplaceComponent<Health>(e3);
+  manager.destroyEntity(e3);
+  removed.clear();
+  manager.synchronize();
+  ES_CHECK(removed.empty());
+  ES_CHECK(added.size() == 3);
+}
+
+static void testRegistrationDuringDispatch() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Health>();
+
+  int outer = 0;
+  int inner = 0;
+
+  manager.registerObserver<Health>(es::ComponentEvent::ADDED, [&](es::ComponentType ct, es::ComponentEvent event, const std::vector<es::Entity>& entities) {
+    outer++;
+
+    for (int i = 0; i < 50; ++i) {
+      manager.registerObserver<Health>(es::ComponentEvent::ADDED, [&](es::ComponentType ct, es::ComponentEvent event, const std::vector<es::Entity>& entities) {
+        inner++;
+        return es::EventStatus::DIE;
+      });
+    }
+
+    return es::EventStatus::DIE;
+  });
+
+  // the observers registered during the dispatch are not notified of the current batch
+  es::Entity e1 = manager.createEntity();
+  manager.emplaceComponent<Health>(e1);
+  manager.synchronize();
+  ES_CHECK(outer == 1);
+  ES_CHECK(inner == 0);
+
+  es::Entity e2 = manager.createEntity();
+  manager.emplaceComponent<Health>(e2);
+  manager.synchronize();
+  ES_CHECK(outer == 1);
+  ES_CHECK(inner == 50);
+}
+
+int main() {
+  testBatches();
+  testRegistrationDuringDispatch();
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <atomic>
+#include <memory>
+
+#include <es/GlobalSystem.h>
+#include <es/Manager.h>
+#include <es/ThreadPool.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 1;
+};
+
+class Increment : public es::GlobalSystem {
+public:
+  Increment(es::Manager *manager)
+  : es::GlobalSystem(1, { Position::type }, manager) {
+    enableParallelUpdate(100);
+    declareAccess({ }, { Position::type });
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    getManager()->writeComponent<Position>(e)->value++;
+  }
+};
+
+class Sum : public es::GlobalSystem {
+public:
+  Sum(es::Manager *manager)
+  : es::GlobalSystem(1, { Position::type }, manager), m_sum(0) {
+    enableParallelUpdate(7);
+    declareAccess({ Position::type }, { });
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    m_sum += getManager()->readComponent<Position>(e)->value;
+  }
+
+  long getSum() const {
+    return m_sum.load();
+  }
+
+private:
+  std::atomic<long> m_sum;
+};
+
+static void testParallelUpdate() {
+  es::Manager manager;
+  manager.setThreadCount(4);
+  manager.createPooledStoreFor<Position>();
+
+  auto increment = std::make_shared<Increment>(&manager);
+  auto sum = std::make_shared<Sum>(&manager);
+  manager.addSystem(increment);
+  manager.addSystem(sum);
+  manager.initSystems();
+
+  for (int i = 0; i < 10000; ++i) {
+    es::Entity e = manager.createEntity();
+    manager.emplaceComponent<Position>(e);
+    manager.subscribeEntityToSystems(e);
+  }
+
+  for (int i = 0; i < 5; ++i) {
+    manager.updateSystems(0.0f);
+  }
+
+  // the sum runs after the increment in each update
+  ES_CHECK(sum->getSum() == 10000L * (1 + 2 + 3 + 4 + 5));
+
+  manager.each<Position>([](es::Entity e, Position& position) {
+    ES_CHECK(position.value == 5);
+  });
+}
+
+static void testParallelFor() {
+  es::ThreadPool pool(3);
+  std::atomic<long> sum(0);
+
+  pool.parallelFor(0, 100000, 10, [&pool, &sum](std::size_t begin, std::size_t end) {
+    // a worker or the calling thread
+    ES_CHECK(pool.getThreadIndex() <= 3);
+
+    for (std::size_t i = begin; i < end; ++i) {
+      sum += static_cast<long>(i);
+    }
+  });
+
+  ES_CHECK(sum == 100000L * 99999L / 2);
+  ES_CHECK(pool.getThreadIndex() == 3);
+
+  // the index of a worker is only valid for its own pool
+  es::ThreadPool other(2);
+  es::TaskGroup group;
+  std::atomic<std::size_t> index(0);
+  pool.submit(group, [&other, &index]() { index = other.getThreadIndex(); });
+  pool.wait(group);
+  ES_CHECK(index == 2);
+}
+
+int main() {
+  testParallelFor();
+  testParallelUpdate();
+  return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include <es/Manager.h>
+#include <es/Pool.h>
+
+#include "Test.h"
+
+struct Tracked : es::Component {
+  Tracked(int v = 0)
+  : value(v) {
+    alive++;
+  }
+
+  ~Tracked() {
+    alive--;
+  }
+
+  int value;
+
+  static int alive;
+  static const es::ComponentType type = 1;
+};
+
+int Tracked::alive = 0;
+
+static void testPool() {
+  {
+    es::ComponentPool<Tracked> pool(4);
+    std::vector<Tracked *> components;
+    std::set<Tracked *> addresses;
+
+    // several chunks
+    for (int i = 0; i < 10; ++i) {
+      Tracked *c = pool.create(i);
+      ES_CHECK(c->value == i);
+      components.push_back(c);
+      addresses.insert(c);
+    }
+
+    ES_CHECK(addresses.size() == 10);
+    ES_CHECK(Tracked::alive == 10);
+    ES_CHECK(reinterpret_cast<uintptr_t>(components[0]) % es::CACHE_LINE_SIZE == 0);
+    ES_CHECK(reinterpret_cast<uintptr_t>(components[4]) % es::CACHE_LINE_SIZE == 0);
+
+    // the slot of a destroyed component is reused
+    pool.destroy(components[3]);
+    ES_CHECK(Tracked::alive == 9);
+    ES_CHECK(pool.create(42) == components[3]);
+    ES_CHECK(components[3]->value == 42);
+    ES_CHECK(components[0]->value == 0);
+
+    pool.destroy(components[9]);
+    ES_CHECK(Tracked::alive == 9);
+  }
+
+  // the pool destroys the components that are still alive, once
+  ES_CHECK(Tracked::alive == 0);
+}
+
+static void testPooledStore() {
+  {
+    es::Manager manager;
+    ES_CHECK(manager.createPooledStoreFor<Tracked>(8));
+    ES_CHECK(!manager.createPooledStoreFor<Tracked>(8));
+
+    std::vector<es::Entity> entities;
+
+    for (int i = 0; i < 20; ++i) {
+      es::Entity e = manager.createEntity();
+      ES_CHECK(manager.emplaceComponent<Tracked>(e, i) != nullptr);
+      entities.push_back(e);
+    }
+
+    ES_CHECK(Tracked::alive == 20);
+    ES_CHECK(manager.getComponent<Tracked>(entities[5])->value == 5);
+
+    // a second component is not created for the same entity
+    ES_CHECK(manager.emplaceComponent<Tracked>(entities[0], 100) == nullptr);
+    ES_CHECK(Tracked::alive == 20);
+
+    ES_CHECK(manager.destroyComponent<Tracked>(entities[0]));
+    ES_CHECK(!manager.destroyComponent<Tracked>(entities[0]));
+    ES_CHECK(manager.getComponent<Tracked>(entities[0]) == nullptr);
+    ES_CHECK(Tracked::alive == 19);
+
+    ES_CHECK(manager.destroyEntity(entities[1]));
+    ES_CHECK(Tracked::alive == 18);
+  }
+
+  // the store destroys its components with the manager
+  ES_CHECK(Tracked::alive == 0);
+}
+
+int main() {
+  testPool();
+  testPooledStore();
+  return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <es/GlobalSystem.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 1;
+};
+
+struct Velocity : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 2;
+};
+
+class Mover : public es::GlobalSystem {
+public:
+  Mover(es::Manager *manager)
+  : es::GlobalSystem(1, { Position::type }, manager) {
+  }
+
+  virtual void update(float delta) override {
+    // the entities of the system that also have a velocity
+    each<Position, const Velocity>([](es::Entity e, Position& position, const Velocity& velocity) {
+      position.value += velocity.value;
+    });
+  }
+};
+
+/*
+ * a position for the even entities and a velocity for the entities that
+ * are multiple of three
+ */
+static std::vector<es::Entity> populate(es::Manager& manager) {
+  std::vector<es::Entity> entities;
+
+  for (int i = 0; i < 30; ++i) {
+    es::Entity e = manager.createEntity();
+
+    if (i % 2 == 0) {
+      manager.emplaceComponent<Position>(e)->value = i;
+    }
+
+    if (i % 3 == 0) {
+      manager.emplaceComponent<Velocity>(e)->value = 100;
+    }
+
+    entities.push_back(e);
+  }
+
+  return entities;
+}
+
+static void testEach(bool archetypes) {
+  es::Manager manager;
+  manager.createPooledStoreFor<Position>();
+  manager.createPooledStoreFor<Velocity>();
+
+  if (archetypes) {
+    manager.enableArchetypes();
+  }
+
+  std::vector<es::Entity> entities = populate(manager);
+  std::map<es::Entity, int> seen;
+
+  manager.each<Position, const Velocity>([&seen](es::Entity e, Position& position, const Velocity& velocity) {
+    ES_CHECK(velocity.value == 100);
+    seen[e] = position.value;
+  });
+
+  ES_CHECK(seen.size() == 5);
+
+  for (int i = 0; i < 30; i += 6) {
+    ES_CHECK(seen[entities[i]] == i);
+  }
+
+  // the entities of the range that do not have all the components are skipped
+  int count = 0;
+
+  manager.each<Velocity>(std::set<es::Entity>{ entities[0], entities[1], entities[3] }, [&count](es::Entity e, Velocity& velocity) {
+    velocity.value++;
+    count++;
+  });
+
+  ES_CHECK(count == 2);
+  ES_CHECK(manager.getComponent<Velocity>(entities[3])->value == 101);
+  ES_CHECK(manager.getComponent<Velocity>(entities[9])->value == 100);
+
+  // a view gives the same entities
+  std::set<es::Entity> viewed;
+
+  manager.getView<const Position, const Velocity>().each([&viewed](es::Entity e, const Position& position, const Velocity& velocity) {
+    viewed.insert(e);
+  });
+
+  ES_CHECK(viewed.size() == 5);
+
+  for (auto& item : seen) {
+    ES_CHECK(viewed.count(item.first) == 1);
+  }
+}
+
+static void testSystemEach() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Position>();
+  manager.createPooledStoreFor<Velocity>();
+
+  auto mover = std::make_shared<Mover>(&manager);
+  manager.addSystem(mover);
+  manager.initSystems();
+
+  std::vector<es::Entity> entities = populate(manager);
+
+  for (es::Entity e : entities) {
+    manager.subscribeEntityToSystems(e);
+  }
+
+  manager.updateSystems(0.0f);
+
+  for (int i = 0; i < 30; i += 2) {
+    ES_CHECK(manager.getComponent<Position>(entities[i])->value == (i % 3 == 0 ? i + 100 : i));
+  }
+}
+
+int main() {
+  testEach(false);
+  testEach(true);
+  testSystemEach();
+  return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <atomic>
+#include <thread>
+
+#include <es/Registry.h>
+
+#include "Test.h"
+
+static void testRegistration() {
+  es::Registry registry(3);
+
+  ES_CHECK(registry.getSize() == 0);
+  ES_CHECK(registry.getIndex(10) == es::INVALID_TYPE_INDEX);
+  ES_CHECK(registry.registerType(INVALID_TYPE) == es::INVALID_TYPE_INDEX);
+
+  // dense indices, in the order of registration
+  ES_CHECK(registry.registerType(30, "Position") == 0);
+  ES_CHECK(registry.registerType(10) == 1);
+  ES_CHECK(registry.registerType(20, "Velocity") == 2);
+  ES_CHECK(registry.getSize() == 3);
+
+  ES_CHECK(registry.registerType(30, "Position") == 0);
+  ES_CHECK(registry.registerType(30) == 0);
+  ES_CHECK(registry.getIndex(10) == 1);
+  ES_CHECK(registry.getType(2) == 20);
+  ES_CHECK(registry.getType(3) == INVALID_TYPE);
+
+  // a name can be given later, but two names with the same hash collide
+  ES_CHECK(registry.registerType(10, "Health") == 1);
+  ES_CHECK(registry.registerType(20, "Renderable") == es::INVALID_TYPE_INDEX);
+
+  // the registry is full
+  ES_CHECK(registry.registerType(40) == es::INVALID_TYPE_INDEX);
+  ES_CHECK(registry.getIndex(40) == es::INVALID_TYPE_INDEX);
+  ES_CHECK(registry.getSize() == 3);
+}
+
+static void testConcurrentLookups() {
+  static const std::size_t COUNT = 1000;
+  es::Registry registry(COUNT);
+  std::atomic<bool> done(false);
+
+  // the lookups do not take the lock while the table is replaced by bigger ones
+  std::thread reader([&registry, &done]() {
+    while (!done.load()) {
+      std::size_t size = registry.getSize();
+
+      for (std::size_t i = 0; i < size; ++i) {
+        ES_CHECK(registry.getIndex(static_cast<es::Type>(i * 7919 + 1)) == i);
+      }
+    }
+  });
+
+  for (std::size_t i = 0; i < COUNT; ++i) {
+    ES_CHECK(registry.registerType(static_cast<es::Type>(i * 7919 + 1)) == i);
+  }
+
+  done = true;
+  reader.join();
+
+  for (std::size_t i = 0; i < COUNT; ++i) {
+    ES_CHECK(registry.getIndex(static_cast<es::Type>(i * 7919 + 1)) == i);
+    ES_CHECK(registry.getType(i) == static_cast<es::Type>(i * 7919 + 1));
+  }
+}
+
+int main() {
+  testRegistration();
+  testConcurrentLookups();
+  return 0;
+}
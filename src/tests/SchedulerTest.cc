@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <es/CustomSystem.h>
+#include <es/GlobalSystem.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 1;
+};
+
+struct Velocity : es::Component {
+  static const es::ComponentType type = 2;
+};
+
+/*
+ * a system that records the order of the updates and the number of systems
+ * running at the same time
+ */
+class Recorder {
+public:
+  Recorder()
+  : m_running(0), m_maxRunning(0) {
+  }
+
+  void enter() {
+    int running = ++m_running;
+    int max = m_maxRunning.load();
+
+    while (running > max && !m_maxRunning.compare_exchange_weak(max, running)) {
+    }
+  }
+
+  void leave(int id) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_log.push_back(id);
+    }
+
+    --m_running;
+  }
+
+  int getMaxRunning() const {
+    return m_maxRunning.load();
+  }
+
+  std::size_t getPosition(int id) const {
+    return std::find(m_log.begin(), m_log.end(), id) - m_log.begin();
+  }
+
+  const std::vector<int>& getLog() const {
+    return m_log;
+  }
+
+  void clear() {
+    m_log.clear();
+  }
+
+private:
+  std::mutex m_mutex;
+  std::vector<int> m_log;
+  std::atomic<int> m_running;
+  std::atomic<int> m_maxRunning;
+};
+
+class Sleeper : public es::CustomSystem {
+public:
+  Sleeper(es::Manager *manager, Recorder *recorder, int priority, int id)
+  : es::CustomSystem(priority, { }, manager), m_recorder(recorder), m_id(id) {
+  }
+
+  Sleeper(es::Manager *manager, Recorder *recorder, int priority, int id, std::set<es::ComponentType> reads, std::set<es::ComponentType> writes)
+  : es::CustomSystem(priority, { }, manager), m_recorder(recorder), m_id(id) {
+    declareAccess(reads, writes);
+  }
+
+  virtual void update(float delta) override {
+    m_recorder->enter();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    m_recorder->leave(m_id);
+  }
+
+private:
+  Recorder *m_recorder;
+  int m_id;
+};
+
+static void testConflicts() {
+  es::Manager manager;
+  manager.setThreadCount(4);
+
+  Recorder recorder;
+  manager.addSystem<Sleeper>(&manager, &recorder, 1, 1, std::set<es::ComponentType>{ Position::type }, std::set<es::ComponentType>{ });
+  manager.addSystem<Sleeper>(&manager, &recorder, 1, 2, std::set<es::ComponentType>{ Position::type }, std::set<es::ComponentType>{ });
+  // writes what 1 and 2 read
+  manager.addSystem<Sleeper>(&manager, &recorder, 1, 3, std::set<es::ComponentType>{ }, std::set<es::ComponentType>{ Position::type });
+  // no conflict
+  manager.addSystem<Sleeper>(&manager, &recorder, 1, 4, std::set<es::ComponentType>{ }, std::set<es::ComponentType>{ Velocity::type });
+  // no declared access: after all the systems of its priority
+  manager.addSystem<Sleeper>(&manager, &recorder, 1, 5);
+  // a new priority: after all the systems of the previous priority
+  manager.addSystem<Sleeper>(&manager, &recorder, 2, 6, std::set<es::ComponentType>{ }, std::set<es::ComponentType>{ });
+  manager.addSystem<Sleeper>(&manager, &recorder, 2, 7, std::set<es::ComponentType>{ Velocity::type }, std::set<es::ComponentType>{ });
+  manager.initSystems();
+
+  for (int i = 0; i < 3; ++i) {
+    recorder.clear();
+    manager.updateSystems(0.0f);
+
+    ES_CHECK(recorder.getLog().size() == 7);
+    ES_CHECK(recorder.getPosition(3) > recorder.getPosition(1));
+    ES_CHECK(recorder.getPosition(3) > recorder.getPosition(2));
+    ES_CHECK(recorder.getPosition(5) == 4);
+    ES_CHECK(recorder.getPosition(6) > 4);
+    ES_CHECK(recorder.getPosition(7) > 4);
+  }
+
+  ES_CHECK(recorder.getMaxRunning() >= 2);
+}
+
+static void testPriorities() {
+  es::Manager manager;
+  manager.setThreadCount(4);
+
+  Recorder recorder;
+
+  for (int i = 0; i < 4; ++i) {
+    manager.addSystem<Sleeper>(&manager, &recorder, 3 - i, 3 - i, std::set<es::ComponentType>{ }, std::set<es::ComponentType>{ });
+  }
+
+  manager.initSystems();
+  manager.updateSystems(0.0f);
+
+  ES_CHECK(recorder.getMaxRunning() == 1);
+  ES_CHECK((recorder.getLog() == std::vector<int>{ 0, 1, 2, 3 }));
+}
+
+/*
+ * destroys the entities with an odd value and spawns an entity for each
+ * entity with a small even value, during a concurrent update
+ */
+class Splitter : public es::GlobalSystem {
+public:
+  Splitter(es::Manager *manager)
+  : es::GlobalSystem(1, { Position::type }, manager) {
+    enableParallelUpdate(16);
+    declareAccess({ Position::type }, { });
+  }
+
+  virtual void updateEntity(float delta, es::Entity e) override {
+    static Velocity velocity;
+
+    es::Manager *manager = getManager();
+    const Position *position = manager->readComponent<Position>(e);
+
+    if (position->value % 2 != 0) {
+      // the entity is alive until the end of the update
+      ES_CHECK(manager->destroyEntity(e));
+      ES_CHECK(manager->isAlive(e));
+    } else if (position->value < 100) {
+      es::Entity spawned = manager->createEntity();
+      ES_CHECK(!manager->isAlive(spawned));
+      ES_CHECK(manager->addComponent<Velocity>(spawned, &velocity));
+      manager->subscribeEntityToSystems(spawned);
+    }
+  }
+};
+
+static void testStructuralChanges() {
+  es::Manager manager;
+  manager.setThreadCount(4);
+  manager.createPooledStoreFor<Position>();
+  manager.createStoreFor<Velocity>();
+
+  auto splitter = std::make_shared<Splitter>(&manager);
+  manager.addSystem(splitter);
+  manager.initSystems();
+
+  for (int i = 0; i < 200; ++i) {
+    es::Entity e = manager.createEntity();
+    manager.emplaceComponent<Position>(e)->value = i;
+    manager.subscribeEntityToSystems(e);
+  }
+
+  manager.updateSystems(0.0f);
+
+  // 100 odd entities destroyed, 50 entities spawned
+  std::set<es::Entity> entities = manager.getEntities();
+  ES_CHECK(entities.size() == 150);
+
+  std::size_t spawned = 0;
+
+  for (es::Entity e : entities) {
+    if (manager.getComponent<Velocity>(e) != nullptr) {
+      spawned++;
+    }
+  }
+
+  ES_CHECK(spawned == 50);
+}
+
+int main() {
+  testConflicts();
+  testPriorities();
+  testStructuralChanges();
+  return 0;
+}
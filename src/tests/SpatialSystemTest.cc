@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <es/Manager.h>
+#include <es/SpatialSystem.h>
+
+#include "Test.h"
+
+struct Disc : es::Component {
+  float x;
+  float y;
+  float r;
+
+  Disc(float cx, float cy, float radius)
+  : x(cx), y(cy), r(radius) {
+  }
+
+  static const es::ComponentType type = 1;
+};
+
+class Discs : public es::SpatialSystem {
+public:
+  Discs(es::Manager *manager)
+  : es::SpatialSystem(1, { Disc::type }, manager, 0.5f) {
+    bindBounds<Disc>([](const Disc& disc, es::Bounds& bounds) {
+      bounds = { disc.x - disc.r, disc.y - disc.r, disc.x + disc.r, disc.y + disc.r };
+    });
+  }
+};
+
+static float getDistanceSquared(es::Manager& manager, es::Entity e, float x, float y) {
+  const Disc *disc = manager.readComponent<Disc>(e);
+  es::Bounds bounds = { disc->x - disc->r, disc->y - disc->r, disc->x + disc->r, disc->y + disc->r };
+  return bounds.getDistanceSquared(x, y);
+}
+
+static void checkQueries(es::Manager& manager, const Discs& discs, const std::vector<es::Entity>& entities, std::mt19937& engine) {
+  std::uniform_real_distribution<float> coordinate(0.0f, 100.0f);
+  std::uniform_real_distribution<float> size(0.0f, 10.0f);
+
+  for (int i = 0; i < 50; ++i) {
+    float x = coordinate(engine);
+    float y = coordinate(engine);
+    float r = size(engine);
+
+    // the queries are compared with the bounds of the components
+    std::vector<es::Entity> result;
+    discs.queryRadius(x, y, r, result);
+    std::sort(result.begin(), result.end());
+
+    std::vector<es::Entity> expected;
+
+    for (es::Entity e : entities) {
+      if (getDistanceSquared(manager, e, x, y) <= r * r) {
+        expected.push_back(e);
+      }
+    }
+
+    ES_CHECK(result == expected);
+
+    es::Bounds box = { x, y, x + 3 * r, y + r };
+    result.clear();
+    discs.queryBounds(box, result);
+    std::sort(result.begin(), result.end());
+
+    expected.clear();
+
+    for (es::Entity e : entities) {
+      es::Bounds bounds;
+      ES_CHECK(discs.getBounds(e, bounds));
+
+      if (bounds.overlaps(box)) {
+        expected.push_back(e);
+      }
+    }
+
+    ES_CHECK(result == expected);
+
+    result.clear();
+    discs.queryNearest(x, y, 7, result);
+    ES_CHECK(result.size() == std::min<std::size_t>(7, entities.size()));
+
+    std::vector<float> distances;
+
+    for (es::Entity e : entities) {
+      distances.push_back(getDistanceSquared(manager, e, x, y));
+    }
+
+    std::sort(distances.begin(), distances.end());
+
+    for (std::size_t k = 0; k < result.size(); ++k) {
+      ES_CHECK(getDistanceSquared(manager, result[k], x, y) == distances[k]);
+    }
+  }
+}
+
+int main() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Disc>();
+
+  auto discs = std::make_shared<Discs>(&manager);
+  manager.addSystem(discs);
+  manager.initSystems();
+
+  std::mt19937 engine(4);
+  std::uniform_real_distribution<float> coordinate(0.0f, 100.0f);
+  std::uniform_real_distribution<float> radius(0.0f, 2.0f);
+
+  std::vector<es::Entity> entities;
+
+  for (int i = 0; i < 2000; ++i) {
+    es::Entity e = manager.createEntity();
+    manager.emplaceComponent<Disc>(e, coordinate(engine), coordinate(engine), radius(engine));
+    manager.subscribeEntityToSystems(e);
+    entities.push_back(e);
+  }
+
+  std::sort(entities.begin(), entities.end());
+  ES_CHECK(discs->getEntityCount() == 2000);
+  ES_CHECK(discs->getHeight() < 30);
+  checkQueries(manager, *discs, entities, engine);
+
+  // the modified entities are refitted at the next update, some leave their enlarged bounds
+  for (int i = 0; i < 5; ++i) {
+    for (es::Entity e : entities) {
+      if (engine() % 3 == 0) {
+        Disc *disc = manager.writeComponent<Disc>(e);
+        disc->x += radius(engine) - 1.0f;
+        disc->y += (engine() % 10 == 0) ? 40.0f : radius(engine) - 1.0f;
+      }
+    }
+
+    manager.updateSystems(0.0f);
+    checkQueries(manager, *discs, entities, engine);
+    ES_CHECK(discs->getHeight() < 30);
+  }
+
+  // remove half of the entities
+  std::vector<es::Entity> kept;
+
+  for (std::size_t i = 0; i < entities.size(); ++i) {
+    if (i % 2 == 0) {
+      kept.push_back(entities[i]);
+    } else {
+      manager.destroyEntity(entities[i]);
+    }
+  }
+
+  manager.synchronize();
+  entities = kept;
+  ES_CHECK(discs->getEntityCount() == entities.size());
+  manager.updateSystems(0.0f);
+  checkQueries(manager, *discs, entities, engine);
+
+  for (es::Entity e : entities) {
+    manager.destroyEntity(e);
+  }
+
+  manager.synchronize();
+  ES_CHECK(discs->getEntityCount() == 0);
+  ES_CHECK(discs->getHeight() == 0);
+
+  std::vector<es::Entity> result;
+  discs->queryNearest(1.0f, 1.0f, 3, result);
+  ES_CHECK(result.empty());
+
+  return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <atomic>
+#include <set>
+
+#include <es/Store.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 1;
+};
+
+static std::size_t findSlot(const es::Store& store, es::Entity e) {
+  for (std::size_t i = 0; i < store.getSize(); ++i) {
+    if (store.getEntityAt(i) == e) {
+      return i;
+    }
+  }
+
+  return store.getSize();
+}
+
+static void testAddRemove() {
+  es::Store store;
+  Position components[4];
+  es::Entity entities[4] = {
+    es::makeEntity(1, 0), es::makeEntity(5, 0), es::makeEntity(2, 0), es::makeEntity(100, 0)
+  };
+
+  for (int i = 0; i < 4; ++i) {
+    components[i].value = i;
+    ES_CHECK(store.add(entities[i], &components[i]));
+  }
+
+  ES_CHECK(!store.add(entities[1], &components[0]));
+  ES_CHECK(!store.add(INVALID_ENTITY, &components[0]));
+  ES_CHECK(store.getSize() == 4);
+
+  for (int i = 0; i < 4; ++i) {
+    ES_CHECK(store.has(entities[i]));
+    ES_CHECK(store.get(entities[i]) == &components[i]);
+    ES_CHECK(store.getComponentAt(findSlot(store, entities[i])) == &components[i]);
+  }
+
+  ES_CHECK(!store.has(es::makeEntity(3, 0)));
+  ES_CHECK(!store.has(es::makeEntity(1000, 0)));
+  ES_CHECK(store.get(es::makeEntity(3, 0)) == nullptr);
+
+  // the last entity takes the slot of the removed entity
+  std::size_t slot = findSlot(store, entities[1]);
+  ES_CHECK(store.remove(entities[1]));
+  ES_CHECK(!store.remove(entities[1]));
+  ES_CHECK(!store.has(entities[1]));
+  ES_CHECK(store.getSize() == 3);
+  ES_CHECK(findSlot(store, entities[3]) == slot);
+  ES_CHECK(store.getComponentAt(slot) == &components[3]);
+  ES_CHECK((store.getEntities() == std::set<es::Entity>{ entities[0], entities[2], entities[3] }));
+
+  // the removed component can be added again
+  ES_CHECK(store.add(entities[1], &components[1]));
+  ES_CHECK(store.get(entities[1]) == &components[1]);
+  ES_CHECK(store.getSize() == 4);
+}
+
+static void testGenerations() {
+  es::Store store;
+  Position old, current;
+
+  es::Entity e = es::makeEntity(7, 1);
+  es::Entity recycled = es::makeEntity(7, 2);
+
+  ES_CHECK(store.add(e, &old));
+
+  // a handle with the same index but another generation is not in the store
+  ES_CHECK(!store.has(recycled));
+  ES_CHECK(store.get(recycled) == nullptr);
+  ES_CHECK(!store.remove(recycled));
+
+  // the stale component is replaced
+  ES_CHECK(store.add(recycled, &current));
+  ES_CHECK(store.getSize() == 1);
+  ES_CHECK(!store.has(e));
+  ES_CHECK(store.get(recycled) == &current);
+}
+
+static void testChanges() {
+  std::atomic<uint64_t> clock(1);
+  es::Store store;
+  store.setClock(&clock);
+
+  es::ChangeList *list = store.createChangeList();
+  Position components[3];
+  es::Entity entities[3] = { es::makeEntity(1, 0), es::makeEntity(2, 0), es::makeEntity(3, 0) };
+
+  for (int i = 0; i < 3; ++i) {
+    ES_CHECK(store.add(entities[i], &components[i]));
+  }
+
+  ES_CHECK(list->getSize() == 3);
+  ES_CHECK(store.getChangeTick(entities[0]) == 1);
+  list->clear();
+  clock = 2;
+
+  // only the written and marked components are recorded, once
+  ES_CHECK(store.get(entities[0]) == &components[0]);
+  ES_CHECK(store.read(entities[0]) == &components[0]);
+  ES_CHECK(list->getSize() == 0);
+
+  ES_CHECK(store.write(entities[1]) == &components[1]);
+  ES_CHECK(store.mark(entities[2]));
+  ES_CHECK(store.mark(entities[1]));
+  ES_CHECK(!store.mark(es::makeEntity(4, 0)));
+
+  ES_CHECK(list->getSize() == 2);
+  ES_CHECK(list->getIndexAt(0) == 2);
+  ES_CHECK(list->getIndexAt(1) == 3);
+  ES_CHECK(store.getChangeTick(entities[0]) == 1);
+  ES_CHECK(store.getChangeTick(entities[1]) == 2);
+  ES_CHECK(store.getChangeTick(entities[2]) == 2);
+  ES_CHECK(store.getChangeTick(es::makeEntity(4, 0)) == 0);
+
+  // the list grows with the store
+  Position far;
+  ES_CHECK(store.add(es::makeEntity(5000, 0), &far));
+  ES_CHECK(list->getSize() == 3);
+  ES_CHECK(list->getIndexAt(2) == 5000);
+
+  store.destroyChangeList(list);
+}
+
+int main() {
+  testAddRemove();
+  testGenerations();
+  testChanges();
+  return 0;
+}
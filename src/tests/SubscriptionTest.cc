@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <memory>
+
+#include <es/GlobalSystem.h>
+#include <es/Manager.h>
+
+#include "Test.h"
+
+struct Position : es::Component {
+  static const es::ComponentType type = 1;
+};
+
+struct Velocity : es::Component {
+  static const es::ComponentType type = 2;
+};
+
+struct Poisoned : es::Component {
+  static const es::ComponentType type = 3;
+};
+
+/*
+ * counts the calls made by the manager
+ */
+class Counter : public es::GlobalSystem {
+public:
+  Counter(es::Manager *manager, std::set<es::ComponentType> needed)
+  : es::GlobalSystem(1, needed, manager), m_added(0), m_removed(0) {
+  }
+
+  virtual bool addEntity(es::Entity e) override {
+    m_added++;
+    return es::GlobalSystem::addEntity(e);
+  }
+
+  virtual bool removeEntity(es::Entity e) override {
+    m_removed++;
+    return es::GlobalSystem::removeEntity(e);
+  }
+
+  bool has(es::Entity e) const {
+    return getEntities().count(e) == 1;
+  }
+
+  int getAdded() const {
+    return m_added;
+  }
+
+  int getRemoved() const {
+    return m_removed;
+  }
+
+  void reset() {
+    m_added = m_removed = 0;
+  }
+
+private:
+  int m_added;
+  int m_removed;
+};
+
+static void testSubscriptions() {
+  es::Manager manager;
+  manager.createPooledStoreFor<Position>();
+  manager.createPooledStoreFor<Velocity>();
+  manager.createPooledStoreFor<Poisoned>();
+
+  auto moving = std::make_shared<Counter>(&manager, std::set<es::ComponentType>{ Position::type, Velocity::type });
+  auto poisoned = std::make_shared<Counter>(&manager, std::set<es::ComponentType>{ Poisoned::type });
+  manager.addSystem(moving);
+  manager.addSystem(poisoned);
+  manager.initSystems();
+
+  es::Entity e = manager.createEntity();
+  manager.emplaceComponent<Position>(e);
+  manager.emplaceComponent<Velocity>(e);
+
+  ES_CHECK(manager.subscribeEntityToSystems(e) == 1);
+  ES_CHECK(moving->has(e));
+  ES_CHECK(!poisoned->has(e));
+  moving->reset();
+  poisoned->reset();
+
+  // the same signature: nothing to do
+  ES_CHECK(manager.subscribeEntityToSystems(e) == 1);
+  ES_CHECK(moving->getAdded() == 0 && moving->getRemoved() == 0);
+  ES_CHECK(poisoned->getAdded() == 0 && poisoned->getRemoved() == 0);
+
+  // only the difference is applied
+  manager.emplaceComponent<Poisoned>(e);
+  ES_CHECK(manager.subscribeEntityToSystems(e) == 2);
+  ES_CHECK(moving->getAdded() == 0 && moving->getRemoved() == 0);
+  ES_CHECK(poisoned->getAdded() == 1 && poisoned->getRemoved() == 0);
+  ES_CHECK(poisoned->has(e));
+
+  manager.destroyComponent<Velocity>(e);
+  manager.destroyComponent<Poisoned>(e);
+  moving->reset();
+  poisoned->reset();
+  ES_CHECK(manager.subscribeEntityToSystems(e) == 0);
+  ES_CHECK(moving->getAdded() == 0 && moving->getRemoved() == 1);
+  ES_CHECK(poisoned->getAdded() == 0 && poisoned->getRemoved() == 1);
+  ES_CHECK(!moving->has(e));
+  ES_CHECK(!poisoned->has(e));
+
+  // a new system invalidates the cache
+  auto positioned = std::make_shared<Counter>(&manager, std::set<es::ComponentType>{ Position::type });
+  manager.addSystem(positioned);
+  manager.initSystems();
+  ES_CHECK(manager.subscribeEntityToSystems(e) == 1);
+  ES_CHECK(positioned->has(e));
+  ES_CHECK(!moving->has(e));
+
+  // an explicit set of component types
+  ES_CHECK(manager.subscribeEntityToSystems(e, { Position::type, Velocity::type }) == 2);
+  ES_CHECK(moving->has(e));
+  ES_CHECK(positioned->has(e));
+}
+
+int main() {
+  testSubscriptions();
+  return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2013-2014, Julien Bernard
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <es/Manager.h>
+#include <es/Registry.h>
+
+#include "Test.h"
+
+// types with large hashes, as given by the _type literal
+struct Position : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 0x9e3779b97f4a7c15;
+};
+
+struct Velocity : es::Component {
+  int value = 0;
+  static const es::ComponentType type = 0xc2b2ae3d27d4eb4f;
+};
+
+struct Hit : es::Event {
+  static const es::EventType type = 0x165667b19e3779f9;
+};
+
+static void testStores() {
+  es::Manager manager;
+
+  // a store created with the type is found with the template, and conversely
+  ES_CHECK(manager.createStoreFor(Velocity::type));
+  ES_CHECK(manager.createStoreFor<Position>());
+  ES_CHECK(!manager.createStoreFor(Position::type));
+
+  ES_CHECK(manager.getStore(Position::type) == manager.getStore<Position>());
+  ES_CHECK(manager.getStore(Velocity::type) == manager.getStore<Velocity>());
+  ES_CHECK(manager.getStore<Position>() != manager.getStore<Velocity>());
+  ES_CHECK(manager.getStore(0x27d4eb2f165667c5) == nullptr);
+
+  std::size_t index = es::Registry::getComponentIndex<Position>();
+  ES_CHECK(index != es::INVALID_TYPE_INDEX);
+  ES_CHECK(es::Registry::getComponentRegistry().getIndex(Position::type) == index);
+  ES_CHECK(es::Registry::getComponentRegistry().getType(index) == Position::type);
+
+  es::Entity e = manager.createEntity();
+  Position position;
+  Velocity velocity;
+  ES_CHECK(manager.addComponent(e, Position::type, &position));
+  ES_CHECK(manager.addComponent<Velocity>(e, &velocity));
+
+  ES_CHECK(manager.getComponent<Position>(e) == &position);
+  ES_CHECK(manager.getComponent(e, Velocity::type) == &velocity);
+  ES_CHECK(manager.getComponent(e, 0x27d4eb2f165667c5) == nullptr);
+
+  manager.extractComponent<Position>(e);
+  manager.extractComponent(e, Velocity::type);
+  ES_CHECK(manager.getComponent<Position>(e) == nullptr);
+  ES_CHECK(manager.getComponent<Velocity>(e) == nullptr);
+}
+
+static void testHandlers() {
+  es::Manager manager;
+  int calls = 0;
+
+  // a handler registered with the type receives the events triggered with the template
+  manager.registerHandler(Hit::type, [&calls](es::Entity origin, es::EventType type, es::Event *event) {
+    ES_CHECK(type == Hit::type);
+    calls++;
+    return es::EventStatus::KEEP;
+  });
+
+  Hit hit;
+  manager.triggerEvent(es::makeEntity(1, 0), &hit);
+  manager.triggerEvent(es::makeEntity(1, 0), Hit::type, &hit);
+  ES_CHECK(calls == 2);
+
+  ES_CHECK(es::Registry::getEventIndex<Hit>() == es::Registry::getEventRegistry().getIndex(Hit::type));
+}
+
+int main() {
+  testStores();
+  testHandlers();
+  return 0;
+}
@@ -8,4 +8,5 @@ mkdir build
 cd build
 cmake $OPTIONS -DCMAKE_INSTALL_PREFIX=$ROOTDIR/opt ../src
 make
+ctest --output-on-failure
 make install